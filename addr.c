@@ -22,39 +22,44 @@
 #include <sys/socket.h>
 #include "netlink.h"
 
-int addr_init(struct addr *dest, int family, int prefixlen, const void *raw)
+void addr_init(struct addr *dest, int family, int prefixlen, const void *raw)
 {
-	char buf[64];
 	unsigned int len = family == AF_INET ? 4 : 16;
 
 	dest->family = family;
 	dest->prefixlen = prefixlen;
-	dest->raw = malloc(len);
-	if (!dest->raw)
-		goto err;
 	memcpy(dest->raw, raw, len);
+	if (len < sizeof(dest->raw))
+		memset(dest->raw + len, 0, sizeof(dest->raw) - len);
+}
 
-	if (!inet_ntop(family, raw, buf, sizeof(buf)))
-		return errno;
-	len = strlen(buf);
-	if (prefixlen >= 0)
-		snprintf(buf + len, sizeof(buf) - len, "/%d", prefixlen);
-	dest->formatted = strdup(buf);
-	if (!dest->formatted)
-		goto err_raw;
-
+int addr_init_nla(struct addr *dest, int family, int prefixlen,
+		  const struct nlattr *nla)
+{
+	if (nla_len(nla) < (family == AF_INET ? 4U : 16U))
+		return EINVAL;
+	addr_init(dest, family, prefixlen, nla_read(nla));
 	return 0;
-
-err_raw:
-	free(dest->raw);
-err:
-	return ENOMEM;
 }
 
 int addr_init_netlink(struct addr *dest, const struct ifaddrmsg *ifa,
 		      const struct nlattr *nla)
 {
-	return addr_init(dest, ifa->ifa_family, ifa->ifa_prefixlen, nla_read(nla));
+	return addr_init_nla(dest, ifa->ifa_family, ifa->ifa_prefixlen, nla);
+}
+
+char *addr_format(const struct addr *addr, char *buf, size_t size)
+{
+	size_t len;
+
+	if (!inet_ntop(addr->family, addr->raw, buf, size)) {
+		snprintf(buf, size, "?");
+		return buf;
+	}
+	len = strlen(buf);
+	if (addr->prefixlen >= 0)
+		snprintf(buf + len, size - len, "/%d", addr->prefixlen);
+	return buf;
 }
 
 int addr_parse_raw(void *dest, const char *src)
@@ -68,7 +73,7 @@ int addr_parse_raw(void *dest, const char *src)
 	return af;
 }
 
-int addr_is_zero(struct addr *addr)
+int addr_is_zero(const struct addr *addr)
 {
 	static const char zero [16];
 	unsigned int len = addr->family == AF_INET ? 4 : 16;
@@ -76,62 +81,37 @@ int addr_is_zero(struct addr *addr)
 	return !memcmp(zero, addr->raw, len);
 }
 
-void addr_destruct(struct addr *addr)
-{
-	if (addr->raw) {
-		free(addr->raw);
-		free(addr->formatted);
-		addr->raw = addr->formatted = NULL;
-	}
-}
-
-int mac_addr_init(struct mac_addr *addr)
+void mac_addr_init(struct mac_addr *addr)
 {
 	addr->len = 0;
-	addr->raw = NULL;
-	addr->formatted = NULL;
-	return 0;
 }
 
-int mac_addr_fill_netlink(struct mac_addr *addr, const struct nlattr *nla)
+void mac_addr_fill_netlink(struct mac_addr *addr, const struct nlattr *nla)
 {
-	const unsigned char *data = nla_read(nla);
 	int len = nla_len(nla);
-	int i;
 
+	if (len > MAC_ADDR_MAX_LEN)
+		len = MAC_ADDR_MAX_LEN;
 	addr->len = len;
-
-	addr->raw = malloc(len);
-	if (!addr->raw)
-		return ENOMEM;
-
-	addr->formatted = malloc(len * 3);
-	if (!addr->raw)
-		goto err_raw;
-
-	memcpy(addr->raw, data, len);
-
-	for (i = 0; i < len; i++)
-		if (3 != snprintf(addr->formatted + i * 3, (i+1 == len) ? 3 : 4 , "%02x:", data[i]))
-			goto err_formatted;
-
-	return 0;
-
-err_formatted:
-	free(addr->formatted);
-	addr->formatted = NULL;
-err_raw:
-	free(addr->raw);
-	addr->raw = NULL;
-	addr->len = 0;
-
-	return errno;
+	memcpy(addr->raw, nla_read(nla), len);
 }
 
-void mac_addr_destruct(struct mac_addr *addr)
+char *mac_addr_format(const struct mac_addr *addr, char *buf, size_t size)
 {
-	if (addr->raw)
-		free(addr->raw);
-	if (addr->formatted)
-		free(addr->formatted);
+	static const char hex[] = "0123456789abcdef";
+	size_t pos = 0;
+	int i;
+
+	if (!size)
+		return buf;
+	/* every byte needs two digits, a separator and room for the
+	 * terminating null */
+	for (i = 0; i < addr->len && pos + (i ? 4 : 3) <= size; i++) {
+		if (i)
+			buf[pos++] = ':';
+		buf[pos++] = hex[addr->raw[i] >> 4];
+		buf[pos++] = hex[addr->raw[i] & 0xf];
+	}
+	buf[pos] = '\0';
+	return buf;
 }
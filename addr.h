@@ -18,27 +18,44 @@
 #define _ADDR_H
 
 #include <arpa/inet.h>
+#include <stddef.h>
 
 struct ifaddrmsg;
 struct nlattr;
 
+/* The addresses are stored inline in the binary form only and formatted
+ * on demand by addr_format and mac_addr_format. An addr with zero family
+ * is not set. */
 struct addr {
 	int family;
 	int prefixlen;
-	char *formatted;
-	void *raw;
+	unsigned char raw[16];
 };
 
+/* the same as MAX_ADDR_LEN of the kernel */
+#define MAC_ADDR_MAX_LEN	32
+
 struct mac_addr {
 	int len;
-	unsigned char *raw;
-	char *formatted;
+	unsigned char raw[MAC_ADDR_MAX_LEN];
 };
 
-int addr_init(struct addr *addr, int ai_family, int prefixlen, const void *raw);
+/* Buffer sizes sufficient for any address. */
+#define ADDR_STR_LEN		(INET6_ADDRSTRLEN + 4)
+#define MAC_ADDR_STR_LEN	(MAC_ADDR_MAX_LEN * 3)
+
+void addr_init(struct addr *addr, int ai_family, int prefixlen, const void *raw);
+/* Initializes the address from a netlink attribute, EINVAL if the attribute
+ * is too short for the family. */
+int addr_init_nla(struct addr *dest, int family, int prefixlen,
+		  const struct nlattr *nla);
 int addr_init_netlink(struct addr *dest, const struct ifaddrmsg *ifa,
 		      const struct nlattr *nla);
 
+/* Formats the address into buf, including the prefix length if it's
+ * not negative. Returns buf. */
+char *addr_format(const struct addr *addr, char *buf, size_t size);
+
 /* dest must point to at least 16 bytes long buffer */
 int addr_parse_raw(void *dest, const char *str);
 
@@ -51,11 +68,13 @@ static inline int addr_max_prefix_len(int ai_family)
 	return 0;
 }
 
-int addr_is_zero(struct addr *addr);
-void addr_destruct(struct addr *addr);
+int addr_is_zero(const struct addr *addr);
 
-int mac_addr_init(struct mac_addr *addr);
-int mac_addr_fill_netlink(struct mac_addr *addr, const struct nlattr *nla);
+void mac_addr_init(struct mac_addr *addr);
+/* Longer addresses than MAC_ADDR_MAX_LEN are truncated. */
+void mac_addr_fill_netlink(struct mac_addr *addr, const struct nlattr *nla);
+/* Formats the address as colon separated hex bytes into buf. Returns
+ * buf. */
+char *mac_addr_format(const struct mac_addr *addr, char *buf, size_t size);
 
-void mac_addr_destruct(struct mac_addr *addr);
 #endif
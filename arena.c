@@ -0,0 +1,162 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "arena.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+/* larger allocations get a chunk of their own */
+#define ARENA_BIG		(ARENA_CHUNK_SIZE / 4)
+/* the same as guaranteed by malloc */
+#define ARENA_ALIGN		16
+
+struct arena_chunk {
+	struct arena_chunk *prev;
+	size_t size, used;
+};
+
+#define ARENA_ALIGN_UP(x, a)	(((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define ARENA_HDR_SIZE		ARENA_ALIGN_UP(sizeof(struct arena_chunk), ARENA_ALIGN)
+#define chunk_data(chunk)	((char *)(chunk) + ARENA_HDR_SIZE)
+
+static struct arena_chunk *arena_new_chunk(size_t size)
+{
+	struct arena_chunk *chunk;
+
+	chunk = malloc(ARENA_HDR_SIZE + size);
+	if (!chunk)
+		return NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+/* The dedicated chunk is linked behind the current one, which thus keeps
+ * serving the small allocations. */
+static void *arena_get_big(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+
+	chunk = arena_new_chunk(size);
+	if (!chunk)
+		return NULL;
+	chunk->used = size;
+	if (arena->chunk) {
+		chunk->prev = arena->chunk->prev;
+		arena->chunk->prev = chunk;
+	} else {
+		chunk->prev = NULL;
+		arena->chunk = chunk;
+	}
+	return chunk_data(chunk);
+}
+
+/* Returns uninitialized memory. */
+static void *arena_get(struct arena *arena, size_t size, size_t align)
+{
+	struct arena_chunk *chunk = arena->chunk;
+	size_t pos = 0;
+
+	if (size > ARENA_BIG)
+		return arena_get_big(arena, size);
+	if (chunk)
+		pos = ARENA_ALIGN_UP(chunk->used, align);
+	if (!chunk || pos + size > chunk->size) {
+		chunk = arena_new_chunk(ARENA_CHUNK_SIZE);
+		if (!chunk)
+			return NULL;
+		chunk->prev = arena->chunk;
+		arena->chunk = chunk;
+		pos = 0;
+	}
+	chunk->used = pos + size;
+	return chunk_data(chunk) + pos;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	void *res;
+
+	res = arena_get(arena, size, ARENA_ALIGN);
+	if (res)
+		memset(res, 0, size);
+	return res;
+}
+
+char *arena_strdup(struct arena *arena, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *res;
+
+	res = arena_get(arena, len, 1);
+	if (res)
+		memcpy(res, s, len);
+	return res;
+}
+
+/* The string is formatted directly into the current chunk if it fits,
+ * which is the common case; otherwise it's formatted again once the
+ * length is known. */
+char *arena_vprintf(struct arena *arena, const char *fmt, va_list ap)
+{
+	struct arena_chunk *chunk = arena->chunk;
+	size_t avail = 0;
+	char *res = NULL;
+	va_list aq;
+	int len;
+
+	if (chunk) {
+		avail = chunk->size - chunk->used;
+		res = chunk_data(chunk) + chunk->used;
+	}
+	va_copy(aq, ap);
+	len = vsnprintf(res, avail, fmt, aq);
+	va_end(aq);
+	if (len < 0)
+		return NULL;
+	if ((size_t)len < avail) {
+		chunk->used += len + 1;
+		return res;
+	}
+	res = arena_get(arena, len + 1, 1);
+	if (res)
+		vsnprintf(res, len + 1, fmt, ap);
+	return res;
+}
+
+char *arena_printf(struct arena *arena, const char *fmt, ...)
+{
+	va_list ap;
+	char *res;
+
+	va_start(ap, fmt);
+	res = arena_vprintf(arena, fmt, ap);
+	va_end(ap);
+	return res;
+}
+
+void arena_free(struct arena *arena)
+{
+	struct arena_chunk *chunk, *prev;
+
+	for (chunk = arena->chunk; chunk; chunk = prev) {
+		prev = chunk->prev;
+		free(chunk);
+	}
+	arena->chunk = NULL;
+}
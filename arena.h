@@ -0,0 +1,48 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Region allocator. Memory is carved from large chunks and released all at
+ * once by arena_free; individual allocations cannot be freed. The arena is
+ * not thread safe, every name space has its own one, used only by the
+ * thread scanning that name space.
+ *
+ * A zeroed arena is a valid empty arena.
+ */
+struct arena_chunk;
+
+struct arena {
+	struct arena_chunk *chunk;
+};
+
+#define ARENA_INITIALIZER	{ .chunk = NULL }
+
+/* Returns zeroed memory, NULL if out of memory. */
+void *arena_alloc(struct arena *arena, size_t size);
+char *arena_strdup(struct arena *arena, const char *s);
+char *arena_printf(struct arena *arena, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+char *arena_vprintf(struct arena *arena, const char *fmt, va_list ap);
+/* Frees everything allocated from the arena. The arena is left empty and
+ * can be reused. */
+void arena_free(struct arena *arena);
+
+#endif
@@ -78,7 +78,10 @@ int arg_parse(int argc, char **argv)
 		}
 		/* find the respective arg_option */
 		if (!gshort_index) {
-			opt = list_tail(options.list);
+			list_for_each(opt, options.list)
+				if (opt->long_name && !glong_index--)
+					break;
+			assert(node_valid(opt));
 		} else {
 			list_for_each(opt, options.list)
 				if (opt->short_name == gshort_index)
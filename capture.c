@@ -0,0 +1,865 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "capture.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "args.h"
+#include "hash.h"
+#include "list.h"
+#include "netlink.h"
+#include "utils.h"
+
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_MAGIC_SWAPPED	0xd4c3b2a1
+#define PCAP_SNAPLEN		262144
+#define LINKTYPE_NETLINK	253
+
+/* The packets start with the Linux cooked header, in network byte order:
+ * packet type, ARPHRD type, address length, 8 bytes of address and the
+ * protocol (the netlink family). */
+#define SLL_HDR_LEN		16
+#define SLL_HOST		0
+#define SLL_OUTGOING		4
+#define SLL_ARPHRD_NETLINK	824
+
+/* values longer than this are split to several records */
+#define CAPTURE_CHUNK		60000
+
+enum {
+	CAPA_UNSPEC,
+	CAPA_KIND,
+	CAPA_KEY,
+	CAPA_VALUE,
+	CAPA_ERR,
+	CAPA_MORE,
+	CAPA_NETNS_ID,
+	CAPA_PID,
+	CAPA_FD,
+	__CAPA_MAX
+};
+
+#define CAPA_MAX	(__CAPA_MAX - 1)
+
+static const struct nla_policy capa_policy[CAPA_MAX + 1] = {
+	[CAPA_KIND]	= { .min_len = sizeof(uint32_t) },
+	[CAPA_KEY]	= { .min_len = 1 },
+	[CAPA_ERR]	= { .min_len = sizeof(uint32_t) },
+	[CAPA_NETNS_ID]	= { .min_len = sizeof(uint64_t) },
+	[CAPA_PID]	= { .min_len = sizeof(uint32_t) },
+	[CAPA_FD]	= { .min_len = sizeof(uint32_t) },
+};
+
+struct pcap_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+};
+
+struct pcap_rec {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+struct capture_dgram {
+	struct capture_dgram *next;
+	int len;
+	char data[];
+};
+
+/* A recorded reply: the datagrams answering a netlink request, or the
+ * value of other data. */
+struct capture_value {
+	struct capture_dgram *dgrams, *last;
+	int err;
+};
+
+/* All the recorded replies to the same request. They are replayed in the
+ * order they were recorded, the last one repeatedly. */
+struct capture_key {
+	struct hash_node n;
+	int kind;		/* 0 for netlink requests */
+	unsigned int netns;
+	int family;
+	struct capture_value *values;
+	int count, next;
+	int len;
+	char data[];
+};
+
+/* netlink requests waiting for their replies while loading */
+struct capture_pending {
+	struct hash_node n;
+	unsigned int port, seq;
+	struct capture_key *key;
+	int index;
+};
+
+struct capture_loader {
+	struct hash_table pending;
+	/* value continued by the next record */
+	struct capture_key *cont;
+};
+
+struct capture_netns {
+	struct node n;
+	char *name;
+	long kernel_id;
+	pid_t pid;
+	int fd;
+};
+
+/* Replay state of a netlink handle. The fd of the handle is one end of
+ * a socket pair; the replies are written to the other end as the reader
+ * consumes them, so that poll and epoll work as with a netlink socket. */
+struct capture_queue {
+	int fd;
+	struct capture_dgram *first, **tail;
+};
+
+static char *record_path, *replay_path;
+static FILE *record_file;
+/* the first error writing the record file, reported by capture_finish */
+static int record_err;
+static int replaying;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct hash_table keys;
+static DECLARE_LIST(netns_records);
+static unsigned int replay_port;
+static __thread unsigned int current_netns;
+
+int capture_recording(void)
+{
+	return record_file != NULL;
+}
+
+int capture_replaying(void)
+{
+	return replaying;
+}
+
+void capture_set_netns(unsigned int netns)
+{
+	current_netns = netns;
+}
+
+unsigned int capture_get_netns(void)
+{
+	return current_netns;
+}
+
+/* recording */
+
+static void capture_write(int type, unsigned int netns, unsigned int port,
+			  int family, const struct iovec *iov, int iovlen)
+{
+	unsigned char sll[SLL_HDR_LEN];
+	struct pcap_rec rec;
+	struct timeval tv;
+	uint16_t val16;
+	uint32_t val32;
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+	gettimeofday(&tv, NULL);
+	rec.ts_sec = tv.tv_sec;
+	rec.ts_usec = tv.tv_usec;
+	rec.incl_len = rec.orig_len = SLL_HDR_LEN + len;
+
+	val16 = htons(type);
+	memcpy(sll, &val16, 2);
+	val16 = htons(SLL_ARPHRD_NETLINK);
+	memcpy(sll + 2, &val16, 2);
+	val16 = htons(8);
+	memcpy(sll + 4, &val16, 2);
+	val32 = htonl(netns);
+	memcpy(sll + 6, &val32, 4);
+	val32 = htonl(port);
+	memcpy(sll + 10, &val32, 4);
+	val16 = htons(family);
+	memcpy(sll + 14, &val16, 2);
+
+	if (record_err)
+		return;
+	if (fwrite(&rec, sizeof(rec), 1, record_file) != 1 ||
+	    fwrite(sll, sizeof(sll), 1, record_file) != 1)
+		goto error;
+	for (i = 0; i < iovlen; i++)
+		if (iov[i].iov_len &&
+		    fwrite(iov[i].iov_base, iov[i].iov_len, 1, record_file) != 1)
+			goto error;
+	return;
+error:
+	record_err = errno ? : EIO;
+}
+
+void capture_nl_sent(struct nl_handle *hnd, const struct msghdr *msg)
+{
+	if (!record_file)
+		return;
+	pthread_mutex_lock(&capture_lock);
+	capture_write(SLL_OUTGOING, hnd->netns, hnd->pid, hnd->family,
+		      msg->msg_iov, msg->msg_iovlen);
+	pthread_mutex_unlock(&capture_lock);
+}
+
+void capture_nl_received(struct nl_handle *hnd, const void *buf, int len)
+{
+	struct iovec iov = {
+		.iov_base = (void *)buf,
+		.iov_len = len,
+	};
+
+	if (!record_file)
+		return;
+	pthread_mutex_lock(&capture_lock);
+	capture_write(SLL_HOST, hnd->netns, hnd->pid, hnd->family, &iov, 1);
+	pthread_mutex_unlock(&capture_lock);
+}
+
+static void capture_write_msg(struct nlmsg *msg)
+{
+	struct iovec iov = {
+		.iov_base = msg->buf,
+		.iov_len = msg->len,
+	};
+
+	capture_write(SLL_HOST, current_netns, 0, NETLINK_USERSOCK, &iov, 1);
+}
+
+void capture_put(int kind, const char *key, const void *val, int len, int err)
+{
+	struct nlmsg *msg;
+	int chunk;
+
+	if (!record_file)
+		return;
+	if (err)
+		len = 0;
+	pthread_mutex_lock(&capture_lock);
+	do {
+		chunk = len > CAPTURE_CHUNK ? CAPTURE_CHUNK : len;
+		msg = nlmsg_new(NLMSG_NOOP, 0);
+		if (!msg)
+			break;
+		if (nla_put_u32(msg, CAPA_KIND, kind) ||
+		    nla_put_str(msg, CAPA_KEY, key) ||
+		    (err && nla_put_u32(msg, CAPA_ERR, err)) ||
+		    (!err && nla_put(msg, CAPA_VALUE, val, chunk)) ||
+		    (len > chunk && nla_put_u8(msg, CAPA_MORE, 1))) {
+			nlmsg_free(msg);
+			break;
+		}
+		capture_write_msg(msg);
+		nlmsg_free(msg);
+		val = (const char *)val + chunk;
+		len -= chunk;
+	} while (len > 0);
+	pthread_mutex_unlock(&capture_lock);
+}
+
+void capture_put_netns(const char *name, long kernel_id, pid_t pid, int fd)
+{
+	uint64_t id = kernel_id;
+	struct nlmsg *msg;
+
+	if (!record_file)
+		return;
+	msg = nlmsg_new(NLMSG_NOOP, 0);
+	if (!msg)
+		return;
+	if (!nla_put_u32(msg, CAPA_KIND, CAPTURE_NETNS) &&
+	    (!name || !nla_put_str(msg, CAPA_KEY, name)) &&
+	    !nla_put(msg, CAPA_NETNS_ID, &id, sizeof(id)) &&
+	    !nla_put_u32(msg, CAPA_PID, pid) &&
+	    !nla_put_u32(msg, CAPA_FD, fd)) {
+		pthread_mutex_lock(&capture_lock);
+		capture_write_msg(msg);
+		pthread_mutex_unlock(&capture_lock);
+	}
+	nlmsg_free(msg);
+}
+
+static int capture_record_start(void)
+{
+	struct pcap_hdr hdr = {
+		.magic = PCAP_MAGIC,
+		.version_major = 2,
+		.version_minor = 4,
+		.snaplen = PCAP_SNAPLEN,
+		.network = LINKTYPE_NETLINK,
+	};
+
+	record_file = fopen(record_path, "w");
+	if (!record_file)
+		return errno;
+	if (fwrite(&hdr, sizeof(hdr), 1, record_file) != 1)
+		return errno;
+	return 0;
+}
+
+/* loading */
+
+static unsigned int capture_key_hash(int kind, unsigned int netns, int family,
+				     const void *data, int len)
+{
+	return hash_mem(data, len) ^ hash_u64((uint64_t)netns << 32 | kind << 16 | family);
+}
+
+static struct capture_key *capture_key_find(int kind, unsigned int netns,
+					    int family, const void *data, int len)
+{
+	struct capture_key *key;
+
+	hash_for_each_match(key, keys, capture_key_hash(kind, netns, family, data, len))
+		if (key->kind == kind && key->netns == netns &&
+		    key->family == family && key->len == len &&
+		    !memcmp(key->data, data, len))
+			return key;
+	return NULL;
+}
+
+/* Appends a new value to the key, creating the key if needed. */
+static int capture_key_add(struct capture_key **result, int kind,
+			   unsigned int netns, int family, const void *data,
+			   int len)
+{
+	struct capture_value *values;
+	struct capture_key *key;
+	int err;
+
+	key = capture_key_find(kind, netns, family, data, len);
+	if (!key) {
+		key = calloc(1, sizeof(*key) + len);
+		if (!key)
+			return ENOMEM;
+		key->kind = kind;
+		key->netns = netns;
+		key->family = family;
+		key->len = len;
+		memcpy(key->data, data, len);
+		err = hash_add(&keys, &key->n,
+			       capture_key_hash(kind, netns, family, data, len));
+		if (err) {
+			free(key);
+			return err;
+		}
+	}
+	values = realloc(key->values, (key->count + 1) * sizeof(*values));
+	if (!values)
+		return ENOMEM;
+	key->values = values;
+	memset(&values[key->count], 0, sizeof(*values));
+	key->count++;
+	*result = key;
+	return 0;
+}
+
+static int capture_value_append(struct capture_value *value, const void *data,
+				int len)
+{
+	struct capture_dgram *dgram;
+
+	dgram = malloc(sizeof(*dgram) + len);
+	if (!dgram)
+		return ENOMEM;
+	dgram->next = NULL;
+	dgram->len = len;
+	memcpy(dgram->data, data, len);
+	if (value->last)
+		value->last->next = dgram;
+	else
+		value->dgrams = dgram;
+	value->last = dgram;
+	return 0;
+}
+
+static void capture_key_free(struct capture_key *key)
+{
+	struct capture_dgram *dgram, *next;
+	int i;
+
+	for (i = 0; i < key->count; i++) {
+		for (dgram = key->values[i].dgrams; dgram; dgram = next) {
+			next = dgram->next;
+			free(dgram);
+		}
+	}
+	free(key->values);
+}
+
+/* Requests are keyed by their content, with the sequence number and the
+ * port id cleared, as those differ between runs. */
+static void *capture_request_key(const struct nlmsghdr *n)
+{
+	struct nlmsghdr *res;
+
+	res = malloc(n->nlmsg_len);
+	if (!res)
+		return NULL;
+	memcpy(res, n, n->nlmsg_len);
+	res->nlmsg_seq = res->nlmsg_pid = 0;
+	return res;
+}
+
+static unsigned int capture_pending_hash(unsigned int port, unsigned int seq)
+{
+	return hash_u64((uint64_t)port << 32 | seq);
+}
+
+static int capture_load_request(struct capture_loader *loader,
+				unsigned int netns, int family,
+				unsigned int port, void *buf, int len)
+{
+	struct capture_pending *pending;
+	struct capture_key *key;
+	struct nlmsghdr *n;
+	unsigned int h;
+	void *data;
+	int err;
+
+	for (n = buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+		data = capture_request_key(n);
+		if (!data)
+			return ENOMEM;
+		err = capture_key_add(&key, 0, netns, family, data, n->nlmsg_len);
+		free(data);
+		if (err)
+			return err;
+
+		h = capture_pending_hash(port, n->nlmsg_seq);
+		hash_for_each_match(pending, loader->pending, h)
+			if (pending->port == port && pending->seq == n->nlmsg_seq)
+				break;
+		if (!pending) {
+			pending = malloc(sizeof(*pending));
+			if (!pending)
+				return ENOMEM;
+			pending->port = port;
+			pending->seq = n->nlmsg_seq;
+			if ((err = hash_add(&loader->pending, &pending->n, h))) {
+				free(pending);
+				return err;
+			}
+		}
+		pending->key = key;
+		pending->index = key->count - 1;
+	}
+	return 0;
+}
+
+static int capture_load_reply(struct capture_loader *loader, unsigned int port,
+			      void *buf, int len)
+{
+	struct capture_pending *pending;
+	struct nlmsghdr *n = buf;
+
+	if (!NLMSG_OK(n, len))
+		return 0;
+	/* The kernel puts replies to different requests to different
+	 * datagrams. */
+	hash_for_each_match(pending, loader->pending,
+			    capture_pending_hash(port, n->nlmsg_seq))
+		if (pending->port == port && pending->seq == n->nlmsg_seq)
+			return capture_value_append(&pending->key->values[pending->index],
+						    buf, len);
+	return 0;
+}
+
+static int capture_load_netns(struct nlattr **tb)
+{
+	struct capture_netns *rec;
+	uint64_t id;
+
+	if (!tb[CAPA_NETNS_ID] || !tb[CAPA_PID] || !tb[CAPA_FD])
+		return EINVAL;
+	rec = calloc(1, sizeof(*rec));
+	if (!rec)
+		return ENOMEM;
+	if (tb[CAPA_KEY]) {
+		rec->name = strdup(nla_read_str(tb[CAPA_KEY]));
+		if (!rec->name) {
+			free(rec);
+			return ENOMEM;
+		}
+	}
+	memcpy(&id, nla_read(tb[CAPA_NETNS_ID]), sizeof(id));
+	rec->kernel_id = id;
+	rec->pid = nla_read_u32(tb[CAPA_PID]);
+	rec->fd = nla_read_u32(tb[CAPA_FD]);
+	list_append(&netns_records, node(rec));
+	return 0;
+}
+
+static int capture_load_meta(struct capture_loader *loader, unsigned int netns,
+			     void *buf, int len)
+{
+	struct nlattr *tb[CAPA_MAX + 1];
+	struct capture_value *value;
+	struct capture_key *key;
+	struct nlmsghdr *n = buf;
+	const char *name;
+	int kind, err;
+
+	if (!NLMSG_OK(n, len) || n->nlmsg_type != NLMSG_NOOP)
+		return 0;
+	nla_parse(tb, CAPA_MAX, NLMSG_DATA(n), n->nlmsg_len - NLMSG_HDRLEN,
+		  capa_policy);
+	if (!tb[CAPA_KIND])
+		return EINVAL;
+	kind = nla_read_u32(tb[CAPA_KIND]);
+	if (kind == CAPTURE_NETNS)
+		return capture_load_netns(tb);
+	if (!tb[CAPA_KEY])
+		return EINVAL;
+
+	name = nla_read_str(tb[CAPA_KEY]);
+	key = loader->cont;
+	if (!key || key->kind != kind || key->netns != netns ||
+	    strcmp(key->data, name)) {
+		err = capture_key_add(&key, kind, netns, 0, name, strlen(name) + 1);
+		if (err)
+			return err;
+	}
+	value = &key->values[key->count - 1];
+	if (tb[CAPA_ERR])
+		value->err = nla_read_u32(tb[CAPA_ERR]);
+	else if (tb[CAPA_VALUE] &&
+		 (err = capture_value_append(value, nla_read(tb[CAPA_VALUE]),
+					     nla_len(tb[CAPA_VALUE]))))
+		return err;
+	loader->cont = tb[CAPA_MORE] ? key : NULL;
+	return 0;
+}
+
+static uint32_t capture_swap32(uint32_t val, int swapped)
+{
+	return swapped ? __builtin_bswap32(val) : val;
+}
+
+static int capture_replay_start(void)
+{
+	struct capture_loader loader = {
+		.pending = HASH_INITIALIZER,
+		.cont = NULL,
+	};
+	unsigned int netns, port;
+	struct pcap_hdr hdr;
+	struct pcap_rec rec;
+	uint16_t type, family;
+	uint32_t len;
+	int swapped, err = 0;
+	char *buf;
+	FILE *f;
+
+	f = fopen(replay_path, "r");
+	if (!f)
+		return errno;
+	buf = malloc(PCAP_SNAPLEN);
+	if (!buf) {
+		err = ENOMEM;
+		goto out;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1) {
+		err = EINVAL;
+		goto out;
+	}
+	swapped = hdr.magic == PCAP_MAGIC_SWAPPED;
+	if ((!swapped && hdr.magic != PCAP_MAGIC) ||
+	    capture_swap32(hdr.network, swapped) != LINKTYPE_NETLINK) {
+		err = EINVAL;
+		goto out;
+	}
+	while (!err && fread(&rec, sizeof(rec), 1, f) == 1) {
+		len = capture_swap32(rec.incl_len, swapped);
+		if (len < SLL_HDR_LEN || len > PCAP_SNAPLEN ||
+		    fread(buf, len, 1, f) != 1) {
+			err = EINVAL;
+			break;
+		}
+		memcpy(&type, buf, 2);
+		memcpy(&netns, buf + 6, 4);
+		memcpy(&port, buf + 10, 4);
+		memcpy(&family, buf + 14, 2);
+		type = ntohs(type);
+		netns = ntohl(netns);
+		port = ntohl(port);
+		family = ntohs(family);
+		len -= SLL_HDR_LEN;
+
+		if (family == NETLINK_USERSOCK)
+			err = capture_load_meta(&loader, netns, buf + SLL_HDR_LEN, len);
+		else if (type == SLL_OUTGOING)
+			err = capture_load_request(&loader, netns, family, port,
+						   buf + SLL_HDR_LEN, len);
+		else
+			err = capture_load_reply(&loader, port, buf + SLL_HDR_LEN, len);
+	}
+	if (!err && ferror(f))
+		err = EIO;
+	replaying = 1;
+
+out:
+	hash_free(&loader.pending, NULL);
+	free(buf);
+	fclose(f);
+	return err;
+}
+
+/* replaying */
+
+int capture_get(int kind, const char *name, void **val, int *len)
+{
+	struct capture_dgram *dgram;
+	struct capture_value *value;
+	struct capture_key *key;
+	char *res;
+
+	key = capture_key_find(kind, current_netns, 0, name, strlen(name) + 1);
+	if (!key)
+		return ENOENT;
+	pthread_mutex_lock(&capture_lock);
+	value = &key->values[key->next < key->count ? key->next++ : key->count - 1];
+	pthread_mutex_unlock(&capture_lock);
+	if (value->err)
+		return value->err;
+
+	*len = 0;
+	for (dgram = value->dgrams; dgram; dgram = dgram->next)
+		*len += dgram->len;
+	/* always nul terminated for the convenience of the callers */
+	res = malloc(*len + 1);
+	if (!res)
+		return ENOMEM;
+	*val = res;
+	for (dgram = value->dgrams; dgram; dgram = dgram->next) {
+		memcpy(res, dgram->data, dgram->len);
+		res += dgram->len;
+	}
+	*res = '\0';
+	return 0;
+}
+
+int capture_for_each_netns(capture_netns_cb_t cb, void *arg)
+{
+	struct capture_netns *rec;
+	int err;
+
+	list_for_each(rec, netns_records)
+		if ((err = cb(rec->name, rec->kernel_id, rec->pid, rec->fd, arg)))
+			return err;
+	return 0;
+}
+
+int capture_nl_open(struct nl_handle *hnd)
+{
+	struct capture_queue *queue;
+	int sv[2];
+
+	queue = malloc(sizeof(*queue));
+	if (!queue)
+		return ENOMEM;
+	if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv) < 0) {
+		free(queue);
+		return errno;
+	}
+	queue->fd = sv[1];
+	queue->first = NULL;
+	queue->tail = &queue->first;
+	hnd->fd = sv[0];
+	hnd->replay = queue;
+	pthread_mutex_lock(&capture_lock);
+	hnd->pid = ++replay_port;
+	pthread_mutex_unlock(&capture_lock);
+	return 0;
+}
+
+void capture_nl_close(struct nl_handle *hnd)
+{
+	struct capture_queue *queue = hnd->replay;
+	struct capture_dgram *dgram, *next;
+
+	for (dgram = queue->first; dgram; dgram = next) {
+		next = dgram->next;
+		free(dgram);
+	}
+	close(queue->fd);
+	free(queue);
+	hnd->replay = NULL;
+}
+
+static struct capture_dgram *capture_queue_add(struct capture_queue *queue,
+					       const void *data, int len)
+{
+	struct capture_dgram *dgram;
+
+	dgram = malloc(sizeof(*dgram) + len);
+	if (!dgram)
+		return NULL;
+	dgram->next = NULL;
+	dgram->len = len;
+	memcpy(dgram->data, data, len);
+	*queue->tail = dgram;
+	queue->tail = &dgram->next;
+	return dgram;
+}
+
+/* Moves the queued replies to the socket, as long as they fit. */
+void capture_nl_refill(struct nl_handle *hnd)
+{
+	struct capture_queue *queue = hnd->replay;
+	struct capture_dgram *dgram;
+
+	while ((dgram = queue->first)) {
+		if (send(queue->fd, dgram->data, dgram->len, MSG_DONTWAIT) < 0)
+			break;
+		queue->first = dgram->next;
+		if (!queue->first)
+			queue->tail = &queue->first;
+		free(dgram);
+	}
+}
+
+static int capture_nl_reply(struct nl_handle *hnd, struct nlmsghdr *req)
+{
+	struct capture_queue *queue = hnd->replay;
+	struct {
+		struct nlmsghdr n;
+		struct nlmsgerr e;
+	} nack;
+	struct capture_dgram *dgram, *copy;
+	struct capture_value *value;
+	struct capture_key *key;
+	struct nlmsghdr *n;
+	void *data;
+	int len;
+
+	data = capture_request_key(req);
+	if (!data)
+		return ENOMEM;
+	key = capture_key_find(0, hnd->netns, hnd->family, data, req->nlmsg_len);
+	free(data);
+	if (!key) {
+		/* not recorded */
+		memset(&nack, 0, sizeof(nack));
+		nack.n.nlmsg_len = sizeof(nack);
+		nack.n.nlmsg_type = NLMSG_ERROR;
+		nack.n.nlmsg_seq = req->nlmsg_seq;
+		nack.n.nlmsg_pid = hnd->pid;
+		nack.e.error = -EOPNOTSUPP;
+		nack.e.msg = *req;
+		return capture_queue_add(queue, &nack, sizeof(nack)) ? 0 : ENOMEM;
+	}
+
+	pthread_mutex_lock(&capture_lock);
+	value = &key->values[key->next < key->count ? key->next++ : key->count - 1];
+	pthread_mutex_unlock(&capture_lock);
+	for (dgram = value->dgrams; dgram; dgram = dgram->next) {
+		copy = capture_queue_add(queue, dgram->data, dgram->len);
+		if (!copy)
+			return ENOMEM;
+		len = copy->len;
+		for (n = (void *)copy->data; NLMSG_OK(n, len);
+		     n = NLMSG_NEXT(n, len)) {
+			n->nlmsg_seq = req->nlmsg_seq;
+			n->nlmsg_pid = hnd->pid;
+		}
+	}
+	return 0;
+}
+
+/* Answers the requests in msg from the capture. */
+int capture_nl_replay(struct nl_handle *hnd, const struct msghdr *msg)
+{
+	struct nlmsghdr *n;
+	size_t i;
+	int len, err;
+
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		len = msg->msg_iov[i].iov_len;
+		for (n = msg->msg_iov[i].iov_base; NLMSG_OK(n, len);
+		     n = NLMSG_NEXT(n, len))
+			if ((err = capture_nl_reply(hnd, n)))
+				return err;
+	}
+	capture_nl_refill(hnd);
+	return 0;
+}
+
+/* setup */
+
+int capture_start(void)
+{
+	if (record_path && replay_path)
+		return EINVAL;
+	if (record_path)
+		return capture_record_start();
+	if (replay_path)
+		return capture_replay_start();
+	return 0;
+}
+
+static void capture_netns_destruct(struct capture_netns *rec)
+{
+	free(rec->name);
+}
+
+int capture_finish(void)
+{
+	int err = record_err;
+
+	if (record_file) {
+		if (ferror(record_file) && !err)
+			err = EIO;
+		if (fclose(record_file) && !err)
+			err = errno;
+		record_file = NULL;
+	}
+	hash_free(&keys, (destruct_f)capture_key_free);
+	list_free(&netns_records, (destruct_f)capture_netns_destruct);
+	return err;
+}
+
+static struct arg_option options[] = {
+	{ .long_name = "record", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CHAR, .action.char_var = &record_path,
+	  .help = "save the data read from the kernel to a pcap file" },
+	{ .long_name = "replay", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CHAR, .action.char_var = &replay_path,
+	  .help = "read the data from a file saved by --record instead of the kernel" },
+};
+
+void capture_init(void)
+{
+	arg_register_batch(options, ARRAY_SIZE(options));
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/*
+ * Recording and replaying of the data gathered from the kernel.
+ *
+ * With --record, all netlink traffic is saved to a pcap file (link type
+ * LINKTYPE_NETLINK, as produced by nlmon), together with the other data
+ * read from the system (the list of name spaces, ethtool, sysfs and Open
+ * vSwitch database replies), which are stored as NLMSG_NOOP messages of
+ * the NETLINK_USERSOCK family. With --replay, the netlink requests are
+ * answered from such file and the other data are taken from it, too; no
+ * privileges nor the original name spaces are needed.
+ *
+ * Every packet is tagged with the name space the socket belongs to (the
+ * inode number of the name space, 0 for the root name space) and the port
+ * id of the socket, stored in the link layer address of the packet.
+ */
+
+struct nl_handle;
+
+/* kinds of the recorded non-netlink data */
+enum {
+	CAPTURE_NETNS = 1,
+	CAPTURE_ETHTOOL_DRIVER,
+	CAPTURE_ETHTOOL_PEER,
+	CAPTURE_SYSFS_READ,
+	CAPTURE_SYSFS_REALPATH,
+	CAPTURE_OVSDB,
+	CAPTURE_NL_STRICT,
+};
+
+void capture_init(void);
+int capture_start(void);
+/* Returns the error writing the record file, if any. */
+int capture_finish(void);
+int capture_recording(void);
+int capture_replaying(void);
+
+/* The name space the calling thread is in, used to tag the data. */
+void capture_set_netns(unsigned int netns);
+unsigned int capture_get_netns(void);
+
+/* netlink, used by netlink.c */
+int capture_nl_open(struct nl_handle *hnd);
+void capture_nl_close(struct nl_handle *hnd);
+int capture_nl_replay(struct nl_handle *hnd, const struct msghdr *msg);
+void capture_nl_refill(struct nl_handle *hnd);
+void capture_nl_sent(struct nl_handle *hnd, const struct msghdr *msg);
+void capture_nl_received(struct nl_handle *hnd, const void *buf, int len);
+
+/* Other data, keyed by kind, the current name space and key. err is
+ * the error code of the operation, val is not stored if non-zero.
+ * capture_get returns ENOENT if there's no such record; replayed values
+ * have to be freed by the caller. */
+void capture_put(int kind, const char *key, const void *val, int len, int err);
+int capture_get(int kind, const char *key, void **val, int *len);
+
+/* The list of scanned name spaces. The root name space has NULL name. */
+void capture_put_netns(const char *name, long kernel_id, pid_t pid, int fd);
+typedef int (*capture_netns_cb_t)(const char *name, long kernel_id, pid_t pid,
+				  int fd, void *arg);
+int capture_for_each_netns(capture_netns_cb_t cb, void *arg);
+
+#endif
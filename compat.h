@@ -44,6 +44,18 @@
 #define RTM_MAX (((RTM_GETNSID + 4) & ~3) - 1)
 #endif
 
+#ifndef RTEXT_FILTER_SKIP_STATS
+#define RTEXT_FILTER_SKIP_STATS	(1 << 3)
+#endif
+
+#ifndef SOL_NETLINK
+#define SOL_NETLINK		270
+#endif
+
+#ifndef NETLINK_GET_STRICT_CHK
+#define NETLINK_GET_STRICT_CHK	12
+#endif
+
 #define OVS_VPORT_FAMILY	"ovs_vport"
 #define OVS_VPORT_CMD_GET	3
 #define OVS_VPORT_ATTR_NAME	3
@@ -18,6 +18,7 @@
 #include <linux/ethtool.h>
 #include <linux/sockios.h>
 #include <net/if.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,82 +26,136 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include "capture.h"
 
-static int ethtool_ioctl(const char *ifname, void *data)
+static int ethtool_ioctl(int fd, const char *ifname, void *data)
 {
 	struct ifreq ifr;
-	int fd, err = 0;
 
-	fd = socket(AF_INET, SOCK_DGRAM, 0);
-	if (fd < 0)
-		return errno;
 	memset(&ifr, 0, sizeof(ifr));
 	strcpy(ifr.ifr_name, ifname);
 	ifr.ifr_data = data;
 	if (ioctl(fd, SIOCETHTOOL, &ifr) < 0)
-		err = errno;
-	close(fd);
-	return err;
+		return errno;
+	return 0;
 }
 
-char *ethtool_driver(const char *ifname)
+char *ethtool_driver(int fd, const char *ifname)
 {
 	struct ethtool_drvinfo info;
+	void *val;
+	int err, len;
 
+	if (capture_replaying()) {
+		if (capture_get(CAPTURE_ETHTOOL_DRIVER, ifname, &val, &len))
+			return NULL;
+		return val;
+	}
 	memset(&info, 0, sizeof(info));
 	info.cmd = ETHTOOL_GDRVINFO;
-	if (ethtool_ioctl(ifname, &info))
+	err = ethtool_ioctl(fd, ifname, &info);
+	capture_put(CAPTURE_ETHTOOL_DRIVER, ifname, info.driver,
+		    strlen(info.driver), err);
+	if (err)
 		return NULL;
 	return strdup(info.driver);
 }
 
-unsigned int ethtool_veth_peer(const char *ifname)
+/* Returns the index of the statistic called name, -1 if not found. */
+static int ethtool_find_stat(int fd, const char *ifname, unsigned int n_stats,
+			     const char *name)
 {
-	struct ethtool_drvinfo info;
 	struct ethtool_gstrings *strs;
+	unsigned int i;
+	int res = -1;
+
+	strs = malloc(sizeof(struct ethtool_gstrings) + n_stats * ETH_GSTRING_LEN);
+	if (!strs)
+		return -1;
+	memset(strs, 0, sizeof(struct ethtool_gstrings));
+	strs->cmd = ETHTOOL_GSTRINGS;
+	strs->string_set = ETH_SS_STATS;
+	strs->len = n_stats;
+	if (ethtool_ioctl(fd, ifname, strs) || strs->len != n_stats)
+		goto out;
+	for (i = 0; i < n_stats; i++) {
+		if (!strncmp((char *)strs->data + i * ETH_GSTRING_LEN, name,
+			     ETH_GSTRING_LEN)) {
+			res = i;
+			break;
+		}
+	}
+out:
+	free(strs);
+	return res;
+}
+
+/* The statistics of a veth device are its peer ifindex followed by
+ * per queue counters. The number of statistics thus depends on the number
+ * of queues of the device and has to be queried (ETHTOOL_GDRVINFO) for
+ * every device: ETHTOOL_GSTATS ignores the count passed in and always
+ * copies all of the statistics, the buffer must be large enough. Only
+ * the position of peer_ifindex, which is the same for all devices, is
+ * cached; this saves the ETHTOOL_GSTRINGS query and its buffer of
+ * n_stats * ETH_GSTRING_LEN bytes, leaving two ioctls per device. */
+static int veth_peer_stat = -1;
+static pthread_mutex_t veth_peer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int ethtool_read_veth_peer(int fd, const char *ifname)
+{
+	struct ethtool_drvinfo info;
 	struct ethtool_stats *stats;
-	unsigned int i, res = 0;
+	unsigned int res = 0;
+	int idx;
 
 	memset(&info, 0, sizeof(info));
 	info.cmd = ETHTOOL_GDRVINFO;
-	if (ethtool_ioctl(ifname, &info))
+	if (ethtool_ioctl(fd, ifname, &info))
 		return 0;
 	if (!info.n_stats)
 		return 0;
 
-	strs = malloc(sizeof(struct ethtool_gstrings) + info.n_stats * ETH_GSTRING_LEN);
-	if (!strs)
+	pthread_mutex_lock(&veth_peer_lock);
+	idx = veth_peer_stat;
+	pthread_mutex_unlock(&veth_peer_lock);
+	if (idx < 0) {
+		idx = ethtool_find_stat(fd, ifname, info.n_stats, "peer_ifindex");
+		if (idx < 0)
+			return 0;
+		pthread_mutex_lock(&veth_peer_lock);
+		veth_peer_stat = idx;
+		pthread_mutex_unlock(&veth_peer_lock);
+	}
+	if ((unsigned int)idx >= info.n_stats)
 		return 0;
-	memset(strs, 0, sizeof(struct ethtool_gstrings));
-	strs->cmd = ETHTOOL_GSTRINGS;
-	strs->string_set = ETH_SS_STATS;
-	strs->len = info.n_stats;
-	if (ethtool_ioctl(ifname, strs))
-		goto fail_strs;
-	if (strs->len != info.n_stats)
-		goto fail_strs;
 
 	stats = malloc(sizeof(struct ethtool_stats) + info.n_stats * sizeof(__u64));
 	if (!stats)
-		goto fail_strs;
+		return 0;
 	memset(stats, 0, sizeof(struct ethtool_stats));
 	stats->cmd = ETHTOOL_GSTATS;
 	stats->n_stats = info.n_stats;
-	if (ethtool_ioctl(ifname, stats))
-		goto fail_stats;
-	if (stats->n_stats != info.n_stats)
-		goto fail_stats;
+	if (!ethtool_ioctl(fd, ifname, stats) && stats->n_stats == info.n_stats)
+		res = stats->data[idx];
+	free(stats);
+	return res;
+}
 
-	for (i = 0; i < info.n_stats; i++) {
-		if (!strcmp((char *)strs->data + i * ETH_GSTRING_LEN, "peer_ifindex")) {
-			res = stats->data[i];
-			break;
+unsigned int ethtool_veth_peer(int fd, const char *ifname)
+{
+	unsigned int res = 0;
+	void *val;
+	int len;
+
+	if (capture_replaying()) {
+		if (!capture_get(CAPTURE_ETHTOOL_PEER, ifname, &val, &len)) {
+			if (len == sizeof(res))
+				memcpy(&res, val, sizeof(res));
+			free(val);
 		}
+		return res;
 	}
-
-fail_stats:
-	free(stats);
-fail_strs:
-	free(strs);
+	res = ethtool_read_veth_peer(fd, ifname);
+	capture_put(CAPTURE_ETHTOOL_PEER, ifname, &res, sizeof(res), 0);
 	return res;
 }
@@ -16,7 +16,9 @@
 #ifndef _ETHTOOL_H
 #define _ETHTOOL_H
 
-char *ethtool_driver(const char *ifname);
-unsigned int ethtool_veth_peer(const char *ifname);
+/* fd is an AF_INET socket in the name space of the interface, see
+ * netns_ioctl_sock. */
+char *ethtool_driver(int fd, const char *ifname);
+unsigned int ethtool_veth_peer(int fd, const char *ifname);
 
 #endif
@@ -21,6 +21,7 @@
 #include "../frontend.h"
 #include "../handler.h"
 #include "../if.h"
+#include "../label.h"
 #include "../netns.h"
 #include "../utils.h"
 #include "../version.h"
@@ -33,23 +34,47 @@ static void output_label(FILE *f, struct list *labels)
 		fprintf(f, "\\n%s", ptr->text);
 }
 
+static void output_label_value(FILE *f, struct label_property *prop)
+{
+	char buf[ADDR_STR_LEN];
+
+	switch (prop->value_type) {
+	case LABEL_VALUE_STR:
+		fprintf(f, "%s", prop->value.str);
+		break;
+	case LABEL_VALUE_INT:
+		fprintf(f, "%lld", prop->value.num);
+		break;
+	case LABEL_VALUE_ADDR:
+		fprintf(f, "%s", addr_format(&prop->value.addr, buf, sizeof(buf)));
+		break;
+	case LABEL_VALUE_IFACE:
+		fprintf(f, "%s", prop->value.iface->if_name);
+		break;
+	}
+}
+
 static void output_label_properties(FILE *f, struct list *properties, unsigned int prop_mask)
 {
 	struct label_property *ptr;
 
-	list_for_each(ptr, *properties)
-		if (label_prop_match_mask(ptr->type, prop_mask))
-			fprintf(f, "\\n%s: %s", ptr->key, ptr->value);
+	list_for_each(ptr, *properties) {
+		if (label_prop_match_mask(ptr->type, prop_mask)) {
+			fprintf(f, "\\n%s: ", ptr->key);
+			output_label_value(f, ptr);
+		}
+	}
 }
 
 static void output_addresses(FILE *f, struct list *addresses)
 {
+	char buf[ADDR_STR_LEN];
 	struct if_addr *addr;
 
 	list_for_each(addr, *addresses) {
-		fprintf(f, "\\n%s", addr->addr.formatted);
-		if (addr->peer.formatted)
-			fprintf(f, " peer %s", addr->peer.formatted);
+		fprintf(f, "\\n%s", addr_format(&addr->addr, buf, sizeof(buf)));
+		if (addr->peer.family)
+			fprintf(f, " peer %s", addr_format(&addr->peer, buf, sizeof(buf)));
 	}
 }
 
@@ -61,6 +86,7 @@ static void output_mtu(FILE *f, struct if_entry *ptr)
 
 static void output_ifaces_pass1(FILE *f, struct list *list, unsigned int prop_mask)
 {
+	char buf[MAC_ADDR_STR_LEN];
 	struct if_entry *ptr;
 
 	list_for_each(ptr, *list) {
@@ -71,8 +97,9 @@ static void output_ifaces_pass1(FILE *f, struct list *list, unsigned int prop_ma
 		output_mtu(f, ptr);
 		if (label_prop_match_mask(IF_PROP_CONFIG, prop_mask)) {
 			output_addresses(f, &ptr->addr);
-			if ((ptr->flags & IF_LOOPBACK) == 0 && ptr->mac_addr.formatted)
-				fprintf(f, "\\nmac %s", ptr->mac_addr.formatted);
+			if ((ptr->flags & IF_LOOPBACK) == 0 && ptr->mac_addr.len)
+				fprintf(f, "\\nmac %s",
+					mac_addr_format(&ptr->mac_addr, buf, sizeof(buf)));
 		}
 		fprintf(f, "\"");
 
@@ -39,18 +39,6 @@ static json_t *label_to_array(struct list *labels)
 	return arr;
 }
 
-static json_t *label_properties_to_object(struct list *properties, unsigned int prop_mask)
-{
-	json_t *jobj;
-	struct label_property *prop;
-
-	jobj = json_object();
-	list_for_each(prop, *properties)
-		if (label_prop_match_mask(prop->type, prop_mask))
-			json_object_set_new(jobj, prop->key, json_string(prop->value));
-	return jobj;
-}
-
 static json_t *address_family(int family)
 {
 	switch (family) {
@@ -61,14 +49,45 @@ static json_t *address_family(int family)
 	return json_string("unknown");
 }
 
+static json_t *address_string(struct addr *addr)
+{
+	char buf[ADDR_STR_LEN];
+
+	return json_string(addr_format(addr, buf, sizeof(buf)));
+}
+
 static json_t *address_to_obj(struct addr *addr)
 {
 	json_t *obj = json_object();
 	json_object_set_new(obj, "family", address_family(addr->family));
-	json_object_set_new(obj, "address", json_string(addr->formatted));
+	json_object_set_new(obj, "address", address_string(addr));
 	return obj;
 }
 
+static json_t *label_value(struct label_property *prop)
+{
+	switch (prop->value_type) {
+		case LABEL_VALUE_STR: return json_string(prop->value.str);
+		case LABEL_VALUE_INT: return json_integer(prop->value.num);
+		case LABEL_VALUE_ADDR: return address_to_obj(&prop->value.addr);
+		case LABEL_VALUE_IFACE: return json_string(ifid(prop->value.iface));
+	}
+	/* should not happen */
+	return json_null();
+}
+
+static json_t *label_properties_to_object(struct list *properties, unsigned int prop_mask)
+{
+	json_t *jobj;
+	struct label_property *prop;
+
+	jobj = json_object();
+	list_for_each(prop, *properties)
+		if (label_prop_match_mask(prop->type, prop_mask))
+			json_object_set_new(jobj, prop->key, label_value(prop));
+	return jobj;
+}
+
 static json_t *addresses_to_array(struct list *addresses)
 {
 	json_t *arr, *addr;
@@ -77,7 +96,7 @@ static json_t *addresses_to_array(struct list *addresses)
 	arr = json_array();
 	list_for_each(entry, *addresses) {
 		addr = address_to_obj(&entry->addr);
-		if (entry->peer.formatted)
+		if (entry->peer.family)
 			json_object_set_new(addr, "peer", address_to_obj(&entry->peer));
 		json_array_append_new(arr, addr);
 	}
@@ -102,6 +121,7 @@ static json_t *interfaces_to_array(struct list *list, struct output_entry *outpu
 {
 	struct if_entry *entry, *link, *slave;
 	json_t *ifarr, *ifobj, *children, *parents, *jconn;
+	char buf[MAC_ADDR_STR_LEN];
 	char *s;
 
 	ifarr = json_object();
@@ -115,8 +135,10 @@ static json_t *interfaces_to_array(struct list *list, struct output_entry *outpu
 		if (label_prop_match_mask(IF_PROP_CONFIG, output_entry->print_mask)) {
 			json_object_set_new(ifobj, "addresses", addresses_to_array(&entry->addr));
 			json_object_set_new(ifobj, "mtu", json_integer(entry->mtu));
-			if ((entry->flags & IF_LOOPBACK) == 0 && entry->mac_addr.formatted)
-				json_object_set_new(ifobj, "mac", json_string(entry->mac_addr.formatted));
+			if ((entry->flags & IF_LOOPBACK) == 0 && entry->mac_addr.len)
+				json_object_set_new(ifobj, "mac",
+						    json_string(mac_addr_format(&entry->mac_addr,
+										buf, sizeof(buf))));
 		}
 		json_object_set_new(ifobj, "type", json_string(entry->flags & IF_INTERNAL ?
 							       "internal" :
@@ -179,10 +201,10 @@ static json_t *routes_to_array(struct list *routes)
 	list_for_each(rte, *routes) {
 		ifobj = json_object();
 		if (rte->dst.family)
-			json_object_set_new(ifobj, "destination", json_string(rte->dst.formatted));
+			json_object_set_new(ifobj, "destination", address_string(&rte->dst));
 		json_object_set_new(ifobj, "family", address_family(rte->family));
 		if (rte->gw.family)
-			json_object_set_new(ifobj, "gateway", json_string(rte->gw.formatted));
+			json_object_set_new(ifobj, "gateway", address_string(&rte->gw));
 		if (rte->iif)
 			json_object_set_new(ifobj, "iif", json_string(ifid(rte->iif)));
 		if (!list_empty(rte->metrics)) {
@@ -199,9 +221,9 @@ static json_t *routes_to_array(struct list *routes)
 		json_object_set_new(ifobj, "protocol", json_string(route_protocol(rte->protocol)));
 		json_object_set_new(ifobj, "scope", json_string(route_scope(rte->scope)));
 		if (rte->src.family)
-			json_object_set_new(ifobj, "source", json_string(rte->src.formatted));
+			json_object_set_new(ifobj, "source", address_string(&rte->src));
 		if (rte->prefsrc.family)
-			json_object_set_new(ifobj, "preferred-source", json_string(rte->prefsrc.formatted));
+			json_object_set_new(ifobj, "preferred-source", address_string(&rte->prefsrc));
 		json_object_set_new(ifobj, "tos", json_integer(rte->tos));
 		json_object_set_new(ifobj, "type", json_string(route_type(rte->type)));
 
@@ -237,7 +259,7 @@ static void json_output(FILE *f, struct list *netns_list, struct output_entry *o
 
 	time(&cur);
 	output = json_object();
-	json_object_set_new(output, "format", json_integer(2));
+	json_object_set_new(output, "format", json_integer(3));
 	json_object_set_new(output, "version", json_string(VERSION));
 	json_object_set_new(output, "date", json_string(ctime(&cur)));
 	json_object_set_new(output, "root", json_string(nsid(root)));
@@ -248,6 +270,7 @@ static void json_output(FILE *f, struct list *netns_list, struct output_entry *o
 		json_object_set_new(ns, "name", json_string(entry->name ? entry->name : ""));
 		json_object_set_new(ns, "interfaces", interfaces_to_array(&entry->ifaces, output_entry));
 		json_object_set_new(ns, "routes", rtables_to_array(&entry->rtables));
+		json_object_set_new(ns, "consistent", entry->inconsistent ? json_false() : json_true());
 		if (!list_empty(entry->warnings))
 			json_object_set_new(ns, "warnings", label_to_array(&entry->warnings));
 		json_object_set_new(ns_list, nsid(entry), ns);
@@ -15,16 +15,41 @@
 
 #include "handler.h"
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <linux/rtnetlink.h>
+#include "arena.h"
+#include "args.h"
+#include "hash.h"
 #include "if.h"
+#include "intern.h"
 #include "netns.h"
+#include "utils.h"
 
+#include "compat.h"
 
 static DECLARE_LIST(if_handlers);
 static DECLARE_LIST(netns_handlers);
 static DECLARE_LIST(global_handlers);
 
+/* After handler_setup, if_handlers contains only the generic handlers;
+ * the others are looked up by the driver name. The names are interned,
+ * the lookup compares pointers only. */
+struct driver_handler {
+	struct hash_node n;
+	struct if_handler *h;
+};
+
+static struct hash_table driver_handlers;
+static unsigned int link_ext;
+/* any of the interface handlers has a cleanup callback */
+static int need_cleanup;
+
+static int handler_times;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void if_handler_register(struct if_handler *h)
 {
 	list_append(&if_handlers, node(h));
@@ -40,34 +65,315 @@ void global_handler_register(struct global_handler *h)
 	list_append(&global_handlers, node(h));
 }
 
-static int driver_match(struct if_handler *h, struct if_entry *e)
+/* Handler names and statistics, for --handler-times and for listing the
+ * names accepted by --disable-handler. */
+enum {
+	ROW_INTERFACE,
+	ROW_NETNS,
+	ROW_GLOBAL,
+};
+
+static const char *row_type[] = {
+	[ROW_INTERFACE] = "interface",
+	[ROW_NETNS] = "netns",
+	[ROW_GLOBAL] = "global",
+};
+
+struct handler_row {
+	int type;
+	const char *name;
+	struct handler_stats stats;
+};
+
+static void handler_row_set(struct handler_row *row, int type,
+			    const char *name, struct handler_stats *stats)
 {
-	return !h->driver || (e->driver && !strcmp(h->driver, e->driver));
+	row->type = type;
+	row->name = name ? name : "?";
+	row->stats = *stats;
 }
 
-#define handler_callback(handler, callback, ...)				\
-	((handler)->callback ? (handler)->callback(__VA_ARGS__) : 0)
+/* Returns the rows of all handlers, in no particular order. Before
+ * handler_setup, the driver handlers are still in if_handlers; afterwards,
+ * they are in driver_handlers. */
+static struct handler_row *handler_rows(int *count)
+{
+	struct global_handler *gh;
+	struct netns_handler *nh;
+	struct driver_handler *ptr;
+	struct handler_row *rows;
+	struct if_handler *h;
+	unsigned int i;
+	int n = 0;
 
-#define if_handler_callback(handler, callback, entry, ...)				\
-	(driver_match(handler, entry) ? handler_callback(handler, callback, entry, ##__VA_ARGS__) : 0)
+	list_for_each(h, if_handlers)
+		n++;
+	hash_for_each(ptr, driver_handlers, i)
+		n++;
+	list_for_each(nh, netns_handlers)
+		n++;
+	list_for_each(gh, global_handlers)
+		n++;
+	rows = calloc(n ? n : 1, sizeof(*rows));
+	if (!rows)
+		return NULL;
+	n = 0;
+	list_for_each(h, if_handlers)
+		handler_row_set(&rows[n++], ROW_INTERFACE, h->name, &h->stats);
+	hash_for_each(ptr, driver_handlers, i)
+		handler_row_set(&rows[n++], ROW_INTERFACE, ptr->h->name, &ptr->h->stats);
+	list_for_each(nh, netns_handlers)
+		handler_row_set(&rows[n++], ROW_NETNS, nh->name, &nh->stats);
+	list_for_each(gh, global_handlers)
+		handler_row_set(&rows[n++], ROW_GLOBAL, gh->name, &gh->stats);
+	*count = n;
+	return rows;
+}
 
-int if_handler_init(struct if_entry *entry)
+static int handler_row_cmp_name(const void *a, const void *b)
+{
+	const struct handler_row *ra = a, *rb = b;
+
+	return strcmp(ra->name, rb->name);
+}
+
+static int handler_row_cmp(const void *a, const void *b)
+{
+	const struct handler_row *ra = a, *rb = b;
+
+	if (ra->type != rb->type)
+		return ra->type - rb->type;
+	return handler_row_cmp_name(a, b);
+}
+
+static void handler_print_names(FILE *f)
+{
+	struct handler_row *rows;
+	int i, count;
+
+	rows = handler_rows(&count);
+	if (!rows)
+		return;
+	qsort(rows, count, sizeof(*rows), handler_row_cmp_name);
+	fprintf(f, "Known handlers:");
+	for (i = 0; i < count; i++)
+		if (!i || strcmp(rows[i].name, rows[i - 1].name))
+			fprintf(f, " %s", rows[i].name);
+	fprintf(f, "\n");
+	free(rows);
+}
+
+static int disable_handler(char *arg)
 {
+	struct global_handler *gh;
+	struct netns_handler *nh;
 	struct if_handler *h;
+	int found = 0;
 
-	list_for_each(h, if_handlers) {
-		if (!h->driver || strcmp(h->driver, entry->driver))
-			continue;
+	list_for_each(h, if_handlers)
+		if (h->name && !strcmp(h->name, arg))
+			h->disabled = found = 1;
+	list_for_each(nh, netns_handlers)
+		if (nh->name && !strcmp(nh->name, arg))
+			nh->disabled = found = 1;
+	list_for_each(gh, global_handlers)
+		if (gh->name && !strcmp(gh->name, arg))
+			gh->disabled = found = 1;
+	if (!found) {
+		fprintf(stderr, "Unknown handler: %s\n", arg);
+		handler_print_names(stderr);
+		return 1;
+	}
+	return 0;
+}
 
-		if (h->private_size) {
-			entry->handler_private = calloc(1, h->private_size);
-			if (!entry->handler_private)
-				return ENOMEM;
+static int set_handler_times(_unused char *arg)
+{
+	handler_times = 1;
+	return 0;
+}
+
+static struct arg_option options[] = {
+	{ .long_name = "disable-handler", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = disable_handler,
+	  .help = "do not gather data specific to the given kind of interfaces" },
+	{ .long_name = "handler-times", .short_name = '\0',
+	  .type = ARG_CALLBACK, .action.callback = set_handler_times,
+	  .help = "print the time spent in the individual handlers" },
+};
+
+void handler_init(void)
+{
+	arg_register_batch(options, ARRAY_SIZE(options));
+}
+
+static unsigned int driver_hash(const char *driver)
+{
+	return hash_u64((uintptr_t)driver);
+}
+
+static struct if_handler *driver_handler_find(const char *driver)
+{
+	struct driver_handler *ptr;
+
+	hash_for_each_match(ptr, driver_handlers, driver_hash(driver))
+		if (ptr->h->driver == driver)
+			return ptr->h;
+	return NULL;
+}
+
+int handler_setup(void)
+{
+	struct global_handler *gh, *gnext;
+	struct netns_handler *nh, *nnext;
+	struct if_handler *h, *next;
+	struct driver_handler *ptr;
+	int err;
+
+	for (h = list_head(if_handlers); node_valid(h); h = next) {
+		next = node_next(h);
+		if (h->disabled) {
+			node_remove(node(h));
+			continue;
+		}
+		link_ext |= h->link_ext;
+		if (h->cleanup)
+			need_cleanup = 1;
+		if (!h->driver)
+			continue;
+		node_remove(node(h));
+		h->driver = intern(h->driver);
+		if (!h->driver)
+			return ENOMEM;
+		ptr = malloc(sizeof(*ptr));
+		if (!ptr)
+			return ENOMEM;
+		ptr->h = h;
+		if ((err = hash_add(&driver_handlers, &ptr->n, driver_hash(h->driver)))) {
+			free(ptr);
+			return err;
 		}
+	}
+	if (link_ext & IF_EXT_STATS)
+		link_ext &= ~IF_EXT_STATS;
+	else
+		link_ext |= RTEXT_FILTER_SKIP_STATS;
+
+	for (nh = list_head(netns_handlers); node_valid(nh); nh = nnext) {
+		nnext = node_next(nh);
+		if (nh->disabled)
+			node_remove(node(nh));
+	}
+	for (gh = list_head(global_handlers); node_valid(gh); gh = gnext) {
+		gnext = node_next(gh);
+		if (gh->disabled)
+			node_remove(node(gh));
+	}
+	return 0;
+}
+
+void handler_cleanup(void)
+{
+	hash_free(&driver_handlers, NULL);
+}
+
+unsigned int if_handler_link_ext(void)
+{
+	return link_ext;
+}
+
+int if_handler_need_cleanup(void)
+{
+	return need_cleanup;
+}
+
+static uint64_t handler_clock(void)
+{
+	struct timespec ts;
+
+	if (!handler_times)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void handler_account(struct handler_stats *stats, uint64_t start)
+{
+	uint64_t end;
+
+	if (!handler_times)
+		return;
+	end = handler_clock();
+	pthread_mutex_lock(&stats_lock);
+	stats->ns += end - start;
+	stats->calls++;
+	pthread_mutex_unlock(&stats_lock);
+}
 
-		break;
+/* Handlers sharing the name are printed as one, sorted by the type and
+ * the name. */
+void handler_print_stats(FILE *f)
+{
+	struct handler_row *rows, *row;
+	int i, count;
+
+	if (!handler_times)
+		return;
+	rows = handler_rows(&count);
+	if (!rows)
+		return;
+	qsort(rows, count, sizeof(*rows), handler_row_cmp);
+	for (i = 0; i < count; i++) {
+		row = &rows[i];
+		while (i + 1 < count && !handler_row_cmp(row, &rows[i + 1])) {
+			i++;
+			row->stats.ns += rows[i].stats.ns;
+			row->stats.calls += rows[i].stats.calls;
+		}
+		if (!row->stats.calls)
+			continue;
+		fprintf(f, "%-16s %-10s %10.3f ms %10lu calls\n", row->name,
+			row_type[row->type], row->stats.ns / 1000000.0,
+			row->stats.calls);
 	}
+	free(rows);
+}
 
+#define handler_callback(handler, callback, ...)				\
+	({									\
+		int __res = 0;							\
+		if ((handler)->callback) {					\
+			uint64_t __start = handler_clock();			\
+			__res = (handler)->callback(__VA_ARGS__);		\
+			handler_account(&(handler)->stats, __start);		\
+		}								\
+		__res;								\
+	})
+
+#define handler_callback_void(handler, callback, ...)				\
+	do {									\
+		if ((handler)->callback) {					\
+			uint64_t __start = handler_clock();			\
+			(handler)->callback(__VA_ARGS__);			\
+			handler_account(&(handler)->stats, __start);		\
+		}								\
+	} while (0)
+
+int if_handler_init(struct if_entry *entry)
+{
+	struct if_handler *h;
+
+	if (!entry->driver)
+		return 0;
+	h = driver_handler_find(entry->driver);
+	if (!h)
+		return 0;
+	entry->handler = h;
+	if (h->private_size) {
+		entry->handler_private = arena_alloc(if_arena(entry), h->private_size);
+		if (!entry->handler_private)
+			return ENOMEM;
+	}
 	return 0;
 }
 
@@ -76,8 +382,11 @@ int if_handler_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 	struct if_handler *h;
 	int err;
 
+	if (entry->handler &&
+	    (err = handler_callback(entry->handler, netlink, entry, linkinfo)))
+		return err;
 	list_for_each(h, if_handlers)
-		if ((err = if_handler_callback(h, netlink, entry, linkinfo)))
+		if ((err = handler_callback(h, netlink, entry, linkinfo)))
 			return err;
 
 	return 0;
@@ -88,8 +397,10 @@ int if_handler_scan(struct if_entry *entry)
 	struct if_handler *h;
 	int err;
 
+	if (entry->handler && (err = handler_callback(entry->handler, scan, entry)))
+		return err;
 	list_for_each(h, if_handlers)
-		if ((err = if_handler_callback(h, scan, entry)))
+		if ((err = handler_callback(h, scan, entry)))
 			return err;
 
 	return 0;
@@ -102,11 +413,16 @@ int if_handler_post(struct list *netns_list)
 	struct if_handler *h;
 	int err;
 
-	list_for_each(ns, *netns_list)
-		list_for_each(entry, ns->ifaces)
+	list_for_each(ns, *netns_list) {
+		list_for_each(entry, ns->ifaces) {
+			if (entry->handler &&
+			    (err = handler_callback(entry->handler, post, entry, netns_list)))
+				return err;
 			list_for_each(h, if_handlers)
-				if ((err = if_handler_callback(h, post, entry, netns_list)))
+				if ((err = handler_callback(h, post, entry, netns_list)))
 					return err;
+		}
+	}
 
 	return 0;
 }
@@ -115,11 +431,10 @@ void if_handler_cleanup(struct if_entry *entry)
 {
 	struct if_handler *h;
 
+	if (entry->handler)
+		handler_callback_void(entry->handler, cleanup, entry);
 	list_for_each(h, if_handlers)
-		if_handler_callback(h, cleanup, entry);
-
-	if (entry->handler_private)
-		free(entry->handler_private);
+		handler_callback_void(h, cleanup, entry);
 }
 
 int netns_handler_scan(struct netns_entry *entry)
@@ -139,7 +454,7 @@ void netns_handler_cleanup(struct netns_entry *entry)
 	struct netns_handler *h;
 
 	list_for_each(h, netns_handlers)
-		handler_callback(h, cleanup, entry);
+		handler_callback_void(h, cleanup, entry);
 }
 
 int global_handler_init(void)
@@ -171,5 +486,5 @@ void global_handler_cleanup(struct list *netns_list)
 	struct global_handler *h;
 
 	list_for_each(h, global_handlers)
-		handler_callback(h, cleanup, netns_list);
+		handler_callback_void(h, cleanup, netns_list);
 }
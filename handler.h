@@ -16,6 +16,7 @@
 #ifndef _HANDLER_H
 #define _HANDLER_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include "list.h"
 
@@ -28,38 +29,82 @@ struct nlattr;
  * by setting driver to NULL. Generic handlers are not allowed to use
  * handler_private field in struct if_entry.
  *
+ * The name is used by --disable-handler and --handler-times; handlers of
+ * different types belonging together may share the name.
+ *
  * If you want to use handler_private, private_size bytes will be allocated
- * before any callback is called.
+ * before any callback is called. It's zeroed and allocated from the arena
+ * of the name space, as is everything else gathered about the interface.
+ * Further data of the handler should be allocated from if_arena(entry),
+ * too; such memory lives as long as the interface and is never freed
+ * individually.
  *
  * Callbacks are called in this order:
  *   1. netlink - while reading interface data from netlink
  *   2. scan - while scanning interfaces, sysfs is mounted
  *   3. post - all interfaces are scanned, use this for inter-interface
  *      scanning
- *   4. cleanup - destroy private structure. handler_private itself will be
- *      freed automatically.
+ *   4. cleanup - release resources not allocated from the arena (e.g.
+ *      references held to other objects). Rarely needed; the interfaces
+ *      are not walked at all on teardown if no handler has cleanup.
  */
+/* Pseudo flag for if_handler.link_ext requesting link statistics. */
+#define IF_EXT_STATS	(1U << 31)
+
+/* Time spent in the callbacks of a handler, see --handler-times. */
+struct handler_stats {
+	uint64_t ns;
+	unsigned long calls;
+};
+
 struct if_handler {
 	struct node n;
+	const char *name;
+	/* interned by handler_setup, compare to if_entry->driver by
+	 * pointer afterwards */
 	const char *driver;
 	size_t private_size;
+	/* Extended link data the handler needs: RTEXT_FILTER_* flags (e.g.
+	 * RTEXT_FILTER_VF for VF info) and IF_EXT_STATS. The link dump
+	 * contains only what some of the registered handlers asked for.
+	 * Currently no handler sets it, link dumps thus carry neither VF
+	 * info nor statistics (RTEXT_FILTER_SKIP_STATS). */
+	unsigned int link_ext;
 	int (*netlink)(struct if_entry *entry, struct nlattr **linkinfo);
 	int (*scan)(struct if_entry *entry);
 	int (*post)(struct if_entry *entry, struct list *netns_list);
 	void (*cleanup)(struct if_entry *entry);
+	/* internal */
+	int disabled;
+	struct handler_stats stats;
 };
 
+void handler_init(void);
+/* To be called after the arguments are parsed and before any other
+ * handler function. */
+int handler_setup(void);
+void handler_print_stats(FILE *f);
+void handler_cleanup(void);
+
 void if_handler_register(struct if_handler *h);
+/* Returns the IFLA_EXT_MASK value for link dumps. */
+unsigned int if_handler_link_ext(void);
 int if_handler_init(struct if_entry *entry);
 int if_handler_netlink(struct if_entry *entry, struct nlattr **linkinfo);
 int if_handler_scan(struct if_entry *entry);
 int if_handler_post(struct list *netns_list);
+/* Returns 0 if if_handler_cleanup is a no-op for all interfaces. */
+int if_handler_need_cleanup(void);
 void if_handler_cleanup(struct if_entry *entry);
 
 struct netns_handler {
 	struct node n;
+	const char *name;
 	int (*scan)(struct netns_entry *entry);
 	void (*cleanup)(struct netns_entry *entry);
+	/* internal */
+	int disabled;
+	struct handler_stats stats;
 };
 
 void netns_handler_register(struct netns_handler *h);
@@ -68,9 +113,13 @@ void netns_handler_cleanup(struct netns_entry *entry);
 
 struct global_handler {
 	struct node n;
+	const char *name;
 	int (*init)(void);
 	int (*post)(struct list *netns_list);
 	void (*cleanup)(struct list *netns_list);
+	/* internal */
+	int disabled;
+	struct handler_stats stats;
 };
 
 void global_handler_register(struct global_handler *h);
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include "../arena.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../netlink.h"
@@ -48,15 +49,14 @@ struct bond_private {
 static int bond_netlink(struct if_entry *entry, struct nlattr **linkinfo);
 static int bond_scan(struct if_entry *entry);
 static int bond_post(struct if_entry *entry, struct list *netns_list);
-static void bond_cleanup(struct if_entry *entry);
 
 static struct if_handler h_bond = {
+	.name = "bond",
 	.driver = "bonding",
 	.private_size = sizeof(struct bond_private),
 	.netlink = bond_netlink,
 	.scan = bond_scan,
 	.post = bond_post,
-	.cleanup = bond_cleanup,
 };
 
 void handler_bond_register(void)
@@ -64,16 +64,20 @@ void handler_bond_register(void)
 	if_handler_register(&h_bond);
 }
 
+static const struct nla_policy bond_policy[IFLA_BOND_MAX + 1] = {
+	[IFLA_BOND_MODE]		= { .min_len = sizeof(uint8_t) },
+	[IFLA_BOND_ACTIVE_SLAVE]	= { .min_len = sizeof(uint32_t) },
+};
+
 static int bond_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 {
 	struct bond_private *priv = entry->handler_private;
-	struct nlattr **bondinfo;
+	struct nlattr *bondinfo[IFLA_BOND_MAX + 1];
 
 	if (!linkinfo || !linkinfo[IFLA_INFO_DATA])
 		return ENOENT;
-	bondinfo = nla_nested_attrs(linkinfo[IFLA_INFO_DATA], IFLA_BOND_MAX);
-	if (!bondinfo)
-		return ENOMEM;
+	nla_parse_nested(bondinfo, IFLA_BOND_MAX, linkinfo[IFLA_INFO_DATA],
+			 bond_policy);
 
 	if (bondinfo[IFLA_BOND_MODE]) {
 		priv->mode = nla_read_u8(bondinfo[IFLA_BOND_MODE]) + 1;
@@ -85,7 +89,6 @@ static int bond_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 		priv->active_slave_index = nla_read_u32(bondinfo[IFLA_BOND_ACTIVE_SLAVE]);
 	}
 
-	free(bondinfo);
 	return 0;
 }
 
@@ -139,8 +142,13 @@ static int bond_scan(struct if_entry *entry)
 			priv->mode = 0;
 	}
 
-	if (!priv->active_slave_index)
-		bond_get_sysfs(&priv->active_slave_name, entry, "active_slave");
+	if (!priv->active_slave_index &&
+	    bond_get_sysfs(&dest, entry, "active_slave") > 0) {
+		priv->active_slave_name = arena_strdup(if_arena(entry), dest);
+		free(dest);
+		if (!priv->active_slave_name)
+			return ENOMEM;
+	}
 
 	return 0;
 }
@@ -150,13 +158,13 @@ static int bond_post(struct if_entry *entry, _unused struct list *netns_list)
 	struct if_entry *slave;
 
 	if (priv->mode && *bond_mode_name[priv->mode])
-		if_add_config(entry, "mode", "%s", bond_mode_name[priv->mode]);
+		if_add_config(entry, "mode", str, bond_mode_name[priv->mode]);
 
 	if (priv->active_slave_index || priv->active_slave_name) {
 		list_for_each_member(slave, entry->rev_master, rev_master_node) {
 			if (match_active_slave(slave, entry)) {
 				entry->active_slave = slave;
-				if_add_state(entry, "active slave", "%s", slave->if_name);
+				if_add_state(entry, "active slave", iface, slave);
 			} else {
 				slave->flags |= IF_PASSIVE_SLAVE;
 			}
@@ -164,11 +172,3 @@ static int bond_post(struct if_entry *entry, _unused struct list *netns_list)
 	}
 	return 0;
 }
-
-static void bond_cleanup(struct if_entry *entry)
-{
-	struct bond_private *priv = entry->handler_private;
-
-	if (priv->active_slave_name)
-		free(priv->active_slave_name);
-}
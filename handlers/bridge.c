@@ -25,6 +25,7 @@
 static int bridge_scan(struct if_entry *entry);
 
 static struct if_handler h_bridge = {
+	.name = "bridge",
 	.scan = bridge_scan,
 };
 
@@ -27,11 +27,13 @@
 static int gre_netlink(struct if_entry *entry, struct nlattr **linkinfo);
 
 static struct if_handler h_gre = {
+	.name = "gre",
 	.driver = "gre",
 	.netlink = gre_netlink,
 };
 
 static struct if_handler h_gretap = {
+	.name = "gre",
 	.driver = "gretap",
 	.netlink = gre_netlink,
 };
@@ -42,51 +44,54 @@ void handler_gre_register(void)
 	if_handler_register(&h_gretap);
 }
 
+static const struct nla_policy gre_policy[IFLA_GRE_MAX + 1] = {
+	[IFLA_GRE_LINK]		= { .min_len = sizeof(uint32_t) },
+	[IFLA_GRE_IKEY]		= { .min_len = sizeof(uint32_t) },
+	[IFLA_GRE_OKEY]		= { .min_len = sizeof(uint32_t) },
+	[IFLA_GRE_LOCAL]	= { .min_len = 4 },
+	[IFLA_GRE_REMOTE]	= { .min_len = 4 },
+};
+
 static int gre_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 {
-	struct nlattr **greinfo;
+	struct nlattr *greinfo[IFLA_GRE_MAX + 1];
 	int err, key;
 
 	if (!linkinfo || !linkinfo[IFLA_INFO_DATA])
 		return ENOENT;
 
-	greinfo = nla_nested_attrs(linkinfo[IFLA_INFO_DATA], IFLA_GRE_MAX);
-	if (!greinfo)
-		return ENOMEM;
+	nla_parse_nested(greinfo, IFLA_GRE_MAX, linkinfo[IFLA_INFO_DATA],
+			 gre_policy);
 
 	if (greinfo[IFLA_GRE_LOCAL]) {
 		struct addr addr;
-		if ((err = addr_init(&addr, AF_INET, -1, nla_read(greinfo[IFLA_GRE_LOCAL]))))
-			goto err_attrs;
+		if ((err = addr_init_nla(&addr, AF_INET, -1,
+					 greinfo[IFLA_GRE_LOCAL])))
+			return err;
 		if (!addr_is_zero(&addr))
-			if_add_config(entry, "local", "%s", addr.formatted);
-		addr_destruct(&addr);
+			if_add_config(entry, "local", addr, &addr);
 	}
 
 	if (greinfo[IFLA_GRE_REMOTE]) {
 		struct addr addr;
-		if ((err = addr_init(&addr, AF_INET, -1, nla_read(greinfo[IFLA_GRE_REMOTE]))))
-			goto err_attrs;
+		if ((err = addr_init_nla(&addr, AF_INET, -1,
+					 greinfo[IFLA_GRE_REMOTE])))
+			return err;
 		if (!addr_is_zero(&addr))
-			if_add_config(entry, "remote", "%s", addr.formatted);
-		addr_destruct(&addr);
+			if_add_config(entry, "remote", addr, &addr);
 	}
 
 	if (greinfo[IFLA_GRE_LINK])
-		entry->link_index = nla_read_u8(greinfo[IFLA_GRE_LINK]);
+		entry->link_index = nla_read_u32(greinfo[IFLA_GRE_LINK]);
 
 	if (greinfo[IFLA_GRE_IKEY]) {
 		if ((key = nla_read_u32(greinfo[IFLA_GRE_IKEY])))
-			if_add_config(entry, "ikey", "%u", ntohl(key));
+			if_add_config(entry, "ikey", int, ntohl(key));
 	}
 
 	if (greinfo[IFLA_GRE_OKEY])
 		if ((key = nla_read_u32(greinfo[IFLA_GRE_OKEY])))
-			if_add_config(entry, "okey", "%u", ntohl(key));
+			if_add_config(entry, "okey", int, ntohl(key));
 
 	return 0;
-
-err_attrs:
-	free(greinfo);
-	return err;
 }
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../arena.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../match.h"
@@ -27,12 +28,11 @@ struct netns_entry;
 
 static int iov_scan(struct if_entry *entry);
 static int iov_post(struct if_entry *entry, struct list *netns_list);
-static void iov_cleanup(struct if_entry *entry);
 
 static struct if_handler h_iov = {
+	.name = "iov",
 	.scan = iov_scan,
 	.post = iov_post,
-	.cleanup = iov_cleanup,
 };
 
 void handler_iov_register(void)
@@ -52,7 +52,10 @@ static int iov_scan(struct if_entry *entry)
 	free(path);
 
 	if (resolved) {
-		entry->pci_path = resolved;
+		entry->pci_path = arena_strdup(if_arena(entry), resolved);
+		sysfs_free(resolved);
+		if (!entry->pci_path)
+			return ENOMEM;
 	} else {
 		if (errno == ENOENT)
 			return 0; /* this is not a PCI device */
@@ -66,7 +69,10 @@ static int iov_scan(struct if_entry *entry)
 	free(path);
 
 	if (resolved) {
-		entry->pci_physfn_path = resolved;
+		entry->pci_physfn_path = arena_strdup(if_arena(entry), resolved);
+		sysfs_free(resolved);
+		if (!entry->pci_physfn_path)
+			return ENOMEM;
 	} else {
 		if (errno == ENOENT)
 			return 0; /* this is not a VF */
@@ -101,18 +107,10 @@ static int iov_post(struct if_entry *entry, struct list *netns_list)
 	match.mode = MM_FIRST;
 	match.netns_list = netns_list;
 	match.exclude = entry;
+	match_by_pci_path(&match, entry->pci_physfn_path);
 	if ((err = match_if(&match, match_physfn, entry)))
 		return err;
 	if (!(entry->physfn = match_found(match)))
 		return if_add_warning(entry, "failed to find the iov physfn");
 	return 0;
 }
-
-static void iov_cleanup(struct if_entry *entry)
-{
-	if (entry->pci_path)
-		sysfs_free(entry->pci_path);
-
-	if (entry->pci_physfn_path)
-		sysfs_free(entry->pci_physfn_path);
-}
@@ -16,6 +16,7 @@
 #include "openvswitch.h"
 #include <errno.h>
 #include <jansson.h>
+#include <limits.h>
 #include <net/if.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -25,9 +26,13 @@
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include "../addr.h"
+#include "../arena.h"
 #include "../args.h"
+#include "../capture.h"
 #include "../handler.h"
 #include "../if.h"
+#include "../intern.h"
 #include "../label.h"
 #include "../list.h"
 #include "../master.h"
@@ -42,6 +47,8 @@
 #define OVS_DB_DEFAULT	"/var/run/openvswitch/db.sock";
 static char *db;
 static unsigned int vport_genl_id;
+/* interned driver name of the internal interfaces */
+static const char *ovs_driver;
 
 struct ovs_if {
 	struct node n;
@@ -409,7 +416,7 @@ static char *read_all(int fd)
 
 static int check_vport(struct netns_entry *ns, struct if_entry *entry)
 {
-	struct nl_handle hnd;
+	struct nl_handle *hnd;
 	struct ovs_header oh = { .dp_ifindex = 0 };
 	struct nlmsg *req, *resp;
 	int err = ENOMEM;
@@ -420,18 +427,18 @@ static int check_vport(struct netns_entry *ns, struct if_entry *entry)
 	 */
 	if (!vport_genl_id)
 		return 0;
-	if (netns_switch(ns))
+	if (!ns->genl && netns_switch(ns))
 		return 0;
-	if (genl_open(&hnd))
+	if (netns_genl(ns, &hnd))
 		return 0;
 
 	req = genlmsg_new(vport_genl_id, OVS_VPORT_CMD_GET, 0);
 	if (!req)
-		goto out_hnd;
+		return 0;
 	if (nlmsg_put(req, &oh, sizeof(oh)) ||
 	    nla_put_str(req, OVS_VPORT_ATTR_NAME, entry->if_name))
 		goto out_req;
-	err = nl_exchange(&hnd, req, &resp);
+	err = nl_exchange(hnd, req, &resp);
 	if (err)
 		goto out_req;
 	/* Keep err = 0. We're only interested whether the call succeeds or
@@ -440,8 +447,6 @@ static int check_vport(struct netns_entry *ns, struct if_entry *entry)
 	nlmsg_free(resp);
 out_req:
 	nlmsg_free(req);
-out_hnd:
-	nl_close(&hnd);
 	return !err;
 }
 
@@ -463,8 +468,7 @@ static int link_iface_search(struct if_entry *entry, void *arg)
 	 */
 	if (strcmp(iface->name, entry->if_name))
 		return 0;
-	if (!strcmp(iface->type, "internal") &&
-	    strcmp(entry->driver, "openvswitch"))
+	if (!strcmp(iface->type, "internal") && entry->driver != ovs_driver)
 		return 0;
 
 	/* We've got a match. This still may not mean the interface is
@@ -498,16 +502,17 @@ static int link_iface(struct ovs_if *iface, struct list *netns_list, int require
 
 	match_init(&match);
 	match.netns_list = netns_list;
+	match_by_name(&match, iface->name);
 
 	if ((err = match_if(&match, link_iface_search, iface)))
 		return err;
 	iface->link = match_found(match);
 	if (match_ambiguous(match))
-		return label_add(&root->warnings,
+		return label_add(&root->arena, &root->warnings,
 				 "Failed to map openvswitch interface %s reliably",
 				 iface->name);
 	if (required && !iface->link)
-		return label_add(&root->warnings,
+		return label_add(&root->arena, &root->warnings,
 				 "Failed to map openvswitch interface %s",
 				 iface->name);
 	return 0;
@@ -515,54 +520,62 @@ static int link_iface(struct ovs_if *iface, struct list *netns_list, int require
 
 static struct if_entry *create_iface(char *name, char *br_name, struct netns_entry *root)
 {
+	char buf[NAME_MAX + 1];
 	struct if_entry *entry;
 
-	entry = if_create();
+	entry = if_create(root);
 	if (!entry)
 		return NULL;
-
-	asprintf(&entry->internal_ns, "ovs:%s", br_name);
+	snprintf(buf, sizeof(buf), "ovs:%s", br_name);
+	entry->internal_ns = intern(buf);
 	if (!entry->internal_ns)
-		goto err_entry;
-
-	entry->if_name = strdup(name);
+		return NULL;
+	entry->if_name = arena_strdup(&root->arena, name);
 	if (!entry->if_name)
-		goto err_name;
+		return NULL;
 
-	entry->ns = root;
 	entry->flags |= IF_INTERNAL;
 	list_append(&root->ifaces, node(entry));
+	if (match_index_add(entry))
+		return NULL;
 	return entry;
+}
 
-err_name:
-	free(entry->if_name);
-err_entry:
-	free(entry);
-	return NULL;
+/* The tunnel endpoints may be also "flow", keep them as strings then. */
+static void label_ip(struct if_entry *link, const char *key, const char *ip)
+{
+	struct addr addr;
+
+	addr.family = addr_parse_raw(addr.raw, ip);
+	if (addr.family < 0) {
+		if_add_config(link, key, str, ip);
+		return;
+	}
+	addr.prefixlen = -1;
+	if_add_config(link, key, addr, &addr);
 }
 
 static void label_iface(struct ovs_if *iface)
 {
 	if (iface->type && *iface->type)
-		if_add_config(iface->link, "type", "%s", iface->type);
+		if_add_config(iface->link, "type", str, iface->type);
 	if (iface->local_ip)
-		if_add_config(iface->link, "from", "%s", iface->local_ip);
+		label_ip(iface->link, "from", iface->local_ip);
 	if (iface->remote_ip)
-		if_add_config(iface->link, "to", "%s", iface->remote_ip);
+		label_ip(iface->link, "to", iface->remote_ip);
 	if (iface->key)
-		if_add_config(iface->link, "key", "%s", iface->key);
+		if_add_config(iface->link, "key", str, iface->key);
 }
 
 static void label_port_or_iface(struct ovs_port *port, struct if_entry *link)
 {
 	if (port->tag) {
-		 if (asprintf(&link->edge_label, "tag %u", port->tag) < 0)
-			link->edge_label = NULL;
+		link->edge_label = arena_printf(if_arena(link), "tag %u", port->tag);
 	} else if (port->trunks_count) {
 		char *buf, *ptr;
 		unsigned int i;
 
-		buf = malloc(16 * port->trunks_count + 7 + 1);
+		buf = arena_alloc(if_arena(link), 16 * port->trunks_count + 7 + 1);
 		if (!buf)
 			return;
 		ptr = buf + sprintf(buf, "trunks %u", port->trunks[0]);
@@ -571,7 +584,7 @@ static void label_port_or_iface(struct ovs_port *port, struct if_entry *link)
 		link->edge_label = buf;
 	}
 	if (port->bond_mode)
-		if_add_config(link, "bond mode", "%s", port->bond_mode);
+		if_add_config(link, "bond mode", str, port->bond_mode);
 }
 
 static void link_tunnel(struct ovs_if *iface)
@@ -598,8 +611,11 @@ static int link_patch(struct ovs_if *iface, struct list *netns_list)
 	int err;
 	struct match_desc match;
 
+	if (!iface->peer)
+		return 0;
 	match_init(&match);
 	match.netns_list = netns_list;
+	match_by_name(&match, iface->peer);
 
 	if ((err = match_if(&match, link_patch_search, iface)))
 		return err;
@@ -624,11 +640,11 @@ static int link_ifaces(struct list *netns_list)
 
 	list_for_each(br, br_list) {
 		if (!br->system || !br->system->iface_count)
-			return label_add(&root->warnings,
+			return label_add(&root->arena, &root->warnings,
 					 "Failed to find main interface for openvswitch bridge %s",
 					 br->name);
 		if (br->system->iface_count > 1)
-			return label_add(&root->warnings,
+			return label_add(&root->arena, &root->warnings,
 					 "Main port for openvswitch bridge %s appears to have several interfaces",
 					 br->name);
 		if ((err = link_iface(list_head(br->system->ifaces), netns_list, 1)))
@@ -675,26 +691,43 @@ static int link_ifaces(struct list *netns_list)
 	return 0;
 }
 
-static int ovs_global_post(struct list *netns_list)
+static char *query_ovs(void)
 {
-	char *str;
+	char *str, *res = NULL;
+	void *val;
 	int fd, len;
-	int err;
 
+	if (capture_replaying()) {
+		if (capture_get(CAPTURE_OVSDB, "query", &val, &len))
+			return NULL;
+		return val;
+	}
 	str = construct_query();
+	if (!str)
+		return NULL;
 	len = strlen(str);
 	fd = connect_ovs();
-	if (fd < 0)
-		return 0;
-	if (write(fd, str, len) < len) {
+	if (fd >= 0) {
+		if (write(fd, str, len) == len)
+			res = read_all(fd);
 		close(fd);
-		return 0;
 	}
 	free(str);
-	str = read_all(fd);
+	if (res)
+		capture_put(CAPTURE_OVSDB, "query", res, strlen(res), 0);
+	return res;
+}
+
+static int ovs_global_post(struct list *netns_list)
+{
+	char *str;
+	int err;
+
+	str = query_ovs();
+	if (!str)
+		return 0;
 	parse(&br_list, str);
 	free(str);
-	close(fd);
 	if (list_empty(br_list))
 		return 0;
 	if ((err = link_ifaces(netns_list)))
@@ -713,6 +746,9 @@ static int ovs_global_init(void)
 	struct nl_handle hnd;
 	int err;
 
+	ovs_driver = intern("openvswitch");
+	if (!ovs_driver)
+		return ENOMEM;
 	if ((err = genl_open(&hnd))) {
 		vport_genl_id = 0;
 		return 0; /* intentionally ignored */
@@ -728,6 +764,7 @@ static void ovs_global_cleanup(_unused struct list *netns_list)
 }
 
 static struct global_handler gh_ovs = {
+	.name = "openvswitch",
 	.init = ovs_global_init,
 	.post = ovs_global_post,
 	.cleanup = ovs_global_cleanup,
@@ -15,9 +15,13 @@
 
 #include "route.h"
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../arena.h"
+#include "../args.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../label.h"
@@ -29,19 +33,51 @@
 #include "../compat.h"
 
 static int route_scan(struct netns_entry *entry);
-static void route_cleanup(struct netns_entry *entry);
 
 static struct netns_handler h_route = {
+	.name = "route",
 	.scan = route_scan,
-	.cleanup = route_cleanup,
+};
+
+static struct rtnl_filter filter;
+
+static int set_table(char *arg)
+{
+	unsigned long table;
+	char *endptr;
+
+	if (!strcmp(arg, "main"))
+		filter.table = RT_TABLE_MAIN;
+	else if (!strcmp(arg, "local"))
+		filter.table = RT_TABLE_LOCAL;
+	else if (!strcmp(arg, "default"))
+		filter.table = RT_TABLE_DEFAULT;
+	else {
+		table = strtoul(arg, &endptr, 10);
+		if (!*arg || *endptr || !table || table > UINT_MAX) {
+			fprintf(stderr, "Invalid routing table: %s\n", arg);
+			return 1;
+		}
+		filter.table = table;
+	}
+	return 0;
+}
+
+static struct arg_option options[] = {
+	{ .long_name = "route-table", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = set_table,
+	  .help = "dump only the given routing table (default: all)",
+	},
 };
 
 void handler_route_register(void)
 {
+	arg_register_batch(options, ARRAY_SIZE(options));
 	netns_handler_register(&h_route);
 }
 
-static int route_parse_metrics(struct list *metrics, struct nlattr *mxrta)
+static int route_parse_metrics(struct arena *arena, struct list *metrics,
+			       struct nlattr *mxrta)
 {
 	struct rtmetric *rtm;
 
@@ -49,7 +85,7 @@ static int route_parse_metrics(struct list *metrics, struct nlattr *mxrta)
 		if (a->nla_type >= RTAX_CC_ALGO)
 			continue;
 
-		rtm = calloc(1, sizeof(struct rtmetric));
+		rtm = arena_alloc(arena, sizeof(struct rtmetric));
 		if (!rtm)
 			return ENOMEM;
 
@@ -61,10 +97,22 @@ static int route_parse_metrics(struct list *metrics, struct nlattr *mxrta)
 	return 0;
 }
 
-int route_create_netlink(struct route **rte, struct nlmsg *msg)
+static const struct nla_policy rta_policy[RTA_MAX + 1] = {
+	[RTA_DST]	= { .min_len = 4 },
+	[RTA_SRC]	= { .min_len = 4 },
+	[RTA_IIF]	= { .min_len = sizeof(uint32_t) },
+	[RTA_OIF]	= { .min_len = sizeof(uint32_t) },
+	[RTA_GATEWAY]	= { .min_len = 4 },
+	[RTA_PRIORITY]	= { .min_len = sizeof(uint32_t) },
+	[RTA_PREFSRC]	= { .min_len = 4 },
+	[RTA_TABLE]	= { .min_len = sizeof(uint32_t) },
+};
+
+static int route_create_netlink(struct arena *arena, struct route **rte,
+				struct nlmsg *msg)
 {
+	struct nlattr *tb[RTA_MAX + 1];
 	struct rtmsg *rtmsg;
-	struct nlattr **tb;
 	struct route *r;
 	int err;
 
@@ -77,7 +125,7 @@ int route_create_netlink(struct route **rte, struct nlmsg *msg)
 	if (!rtmsg)
 		return ENOENT;
 
-	r = calloc(1, sizeof(struct route));
+	r = arena_alloc(arena, sizeof(struct route));
 	if (!r)
 		return ENOMEM;
 
@@ -87,11 +135,7 @@ int route_create_netlink(struct route **rte, struct nlmsg *msg)
 	r->tos = rtmsg->rtm_tos;
 	r->type = rtmsg->rtm_type;
 
-	tb = nlmsg_attrs(msg, RTA_MAX);
-	if (!tb) {
-		err = ENOMEM;
-		goto err_rte;
-	}
+	nlmsg_parse(msg, tb, RTA_MAX, rta_policy);
 
 	if (tb[RTA_TABLE])
 		r->table_id = nla_read_u32(tb[RTA_TABLE]);
@@ -99,17 +143,13 @@ int route_create_netlink(struct route **rte, struct nlmsg *msg)
 		r->table_id = rtmsg->rtm_table;
 
 	if (tb[RTA_SRC])
-		addr_init(&r->src, r->family, rtmsg->rtm_src_len,
-			  nla_read(tb[RTA_SRC]));
+		addr_init_nla(&r->src, r->family, rtmsg->rtm_src_len, tb[RTA_SRC]);
 	if (tb[RTA_DST])
-		addr_init(&r->dst, r->family, rtmsg->rtm_dst_len,
-			  nla_read(tb[RTA_DST]));
+		addr_init_nla(&r->dst, r->family, rtmsg->rtm_dst_len, tb[RTA_DST]);
 	if (tb[RTA_GATEWAY])
-		addr_init(&r->gw, r->family, -1,
-			  nla_read(tb[RTA_GATEWAY]));
+		addr_init_nla(&r->gw, r->family, -1, tb[RTA_GATEWAY]);
 	if (tb[RTA_PREFSRC])
-		addr_init(&r->prefsrc, r->family, -1,
-			  nla_read(tb[RTA_PREFSRC]));
+		addr_init_nla(&r->prefsrc, r->family, -1, tb[RTA_PREFSRC]);
 
 	if (tb[RTA_OIF])
 		r->oifindex = nla_read_u32(tb[RTA_OIF]);
@@ -121,25 +161,19 @@ int route_create_netlink(struct route **rte, struct nlmsg *msg)
 
 	list_init(&r->metrics);
 	if (tb[RTA_METRICS])
-		if ((err = route_parse_metrics(&r->metrics, tb[RTA_METRICS])))
-			goto err_tb;
+		if ((err = route_parse_metrics(arena, &r->metrics, tb[RTA_METRICS])))
+			return err;
 
 	*rte = r;
-	free(tb);
 	return 0;
-
-err_tb:
-	free(tb);
-err_rte:
-	free(r);
-	return err;
 }
 
-static int rtable_create(struct rtable **rtd, int id)
+static int rtable_create(struct arena *arena, struct rtable **rtd,
+			 unsigned int id)
 {
 	struct rtable *rt;
 
-	rt = calloc(1, sizeof(struct rtable));
+	rt = arena_alloc(arena, sizeof(struct rtable));
 	if (!rt)
 		return ENOMEM;
 
@@ -150,91 +184,114 @@ static int rtable_create(struct rtable **rtd, int id)
 	return 0;
 }
 
-static struct if_entry *find_if_by_ifindex(struct list *list, unsigned int ifindex)
+/* The tables are kept in ns->rtables sorted by id, descending. Table ids
+ * go up to 2^32 - 1; there are few tables and the routes come grouped by
+ * table, thus the last used table is remembered and the list is searched
+ * only when the table changes. */
+struct route_scan {
+	struct netns_entry *ns;
+	struct rtable *last;
+};
+
+static int route_scan_table(struct route_scan *scan, unsigned int id,
+			    struct rtable **result)
 {
-	struct if_entry *entry;
+	struct rtable *rt, *new;
+	int err;
 
-	list_for_each(entry, *list)
-		if (entry->if_index == ifindex)
-			return entry;
-	return NULL;
+	if (scan->last && scan->last->id == id) {
+		*result = scan->last;
+		return 0;
+	}
+	list_for_each(rt, scan->ns->rtables) {
+		if (rt->id == id)
+			goto out;
+		if (rt->id < id)
+			break;
+	}
+	if ((err = rtable_create(&scan->ns->arena, &new, id)))
+		return err;
+	if (node_valid(rt))
+		list_insert_before(node(rt), node(new));
+	else
+		list_append(&scan->ns->rtables, node(new));
+	rt = new;
+out:
+	*result = scan->last = rt;
+	return 0;
 }
 
-
-int route_scan(struct netns_entry *ns)
+static int route_scan_msg(struct nlmsg *msg, void *arg)
 {
-	struct nl_handle hnd;
-	struct nlmsg *req, *resp;
-	struct rtmsg msg = {
-		.rtm_table = RT_TABLE_UNSPEC,
-		.rtm_protocol = RTPROT_UNSPEC,
-	};
-	struct rtable *tables [256];
-	struct route *r = NULL;
-	int err, i;
-
-	memset(tables, 0, sizeof(tables));
-	list_init(&ns->rtables);
+	struct route_scan *scan = arg;
+	struct rtable *rt;
+	struct route *r;
+	int err;
 
-	if ((err = rtnl_open(&hnd)))
+	if ((err = route_create_netlink(&scan->ns->arena, &r, msg)))
 		return err;
 
-	req = nlmsg_new(RTM_GETROUTE, NLM_F_DUMP);
-	if (!req) {
-		err = ENOMEM;
-		goto err_handle;
-	}
-	err = nlmsg_put(req, &msg, sizeof(msg));
-	if (err)
-		goto err_req;
-
-	err = nl_exchange(&hnd, req, &resp);
-	if (err)
-		goto err_req;
-
-	for_each_nlmsg(nle, resp) {
-		if ((err = route_create_netlink(&r, nle)))
-			goto err_resp;
+	r->oif = if_find_index(scan->ns, r->oifindex);
+	r->iif = if_find_index(scan->ns, r->iifindex);
 
-		r->oif = find_if_by_ifindex(&ns->ifaces, r->oifindex);
-		r->iif = find_if_by_ifindex(&ns->ifaces, r->iifindex);
-
-		if (!tables[r->table_id])
-			if ((err = rtable_create(&tables[r->table_id], r->table_id)))
-				goto err_route;
-
-		list_append(&tables[r->table_id]->routes, node(r));
-		r = NULL;
-	}
+	if ((err = route_scan_table(scan, r->table_id, &rt)))
+		return err;
+	list_append(&rt->routes, node(r));
+	return 0;
+}
 
-	for (i = 255; i >= 0; i--) {
-		if (tables[i])
-			list_append(&ns->rtables, node(tables[i]));
-	}
+/* The dropped routes stay in the arena until the name space is freed. */
+static void route_scan_restart(void *arg)
+{
+	struct route_scan *scan = arg;
 
-err_route:
-	if (r)
-		free(r);
-err_resp:
-	nlmsg_free(resp);
-err_req:
-	nlmsg_free(req);
-err_handle:
-	nl_close(&hnd);
-	return err;
+	list_init(&scan->ns->rtables);
+	scan->last = NULL;
 }
 
-static void route_destruct(struct route *r)
+struct nlmsg *route_dump_req(void)
 {
-	list_free(&r->metrics, NULL);
+	if (h_route.disabled)
+		return NULL;
+	return rtnl_dump_req(RTM_GETROUTE, AF_UNSPEC, &filter);
 }
 
-static void rtable_free(struct rtable *rt)
+static int route_dump(struct route_scan *scan)
 {
-	list_free(&rt->routes, (destruct_f) route_destruct);
+	struct nl_handle *hnd;
+	int err;
+
+	if ((err = netns_rtnl(scan->ns, &hnd)))
+		return err;
+	return rtnl_dump(hnd, RTM_GETROUTE, AF_UNSPEC, &filter, route_scan_msg,
+			 route_scan_restart, scan);
 }
 
-static void route_cleanup(struct netns_entry *entry)
+int route_scan(struct netns_entry *ns)
 {
-	list_free(&entry->rtables, (destruct_f) rtable_free);
+	struct route_scan scan;
+	int err;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.ns = ns;
+	list_init(&ns->rtables);
+
+	if (ns->route_dump) {
+		err = rtnl_dump_list(ns->route_dump, &filter, route_scan_msg, &scan);
+		nlmsg_free(ns->route_dump);
+		ns->route_dump = NULL;
+	} else {
+		err = route_dump(&scan);
+	}
+	if (err == EINTR) {
+		/* Routes are not reconciled, the interrupted dump is used
+		 * as it is. */
+		ns->inconsistent = 1;
+		err = 0;
+	}
+	if (err) {
+		route_scan_restart(&scan);
+		return err;
+	}
+	return 0;
 }
@@ -16,6 +16,11 @@
 #ifndef _HANDLERS_ROUTE_H
 #define _HANDLERS_ROUTE_H
 
+struct nlmsg;
+
 void handler_route_register(void);
+/* Returns the route dump request for --async-dumps, honoring
+ * --route-table. NULL if the handler is disabled. */
+struct nlmsg *route_dump_req(void);
 
 #endif
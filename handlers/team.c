@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include "../arena.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../utils.h"
@@ -43,19 +44,18 @@ struct netns_entry;
 #define TEAMD_REQ TEAMD_REQUEST_PREFIX "\nStateDump\n"
 
 struct team_priv {
-	json_t *active_port_name;
+	char *active_port_name;
 };
 
 static int team_scan(struct if_entry *entry);
 static int team_post(struct if_entry *entry, struct list *netns_list);
-static void team_cleanup(struct if_entry *entry);
 
 static struct if_handler h_team = {
+	.name = "team",
 	.driver = "team",
 	.private_size = sizeof(struct team_priv),
 	.scan = team_scan,
 	.post = team_post,
-	.cleanup = team_cleanup
 };
 
 
@@ -183,10 +183,10 @@ int team_parse_runner(json_t *jrunner, struct if_entry *entry, _unused json_erro
 		return 0;
 
 	jport = json_object_get(jrunner, "active_port");
-	if (jport) {
-		priv->active_port_name = jport;
-		json_incref(jport);
-	}
+	if (jport && json_string_value(jport))
+		/* if out of memory, the active port is just not known */
+		priv->active_port_name = arena_strdup(if_arena(entry),
+						      json_string_value(jport));
 
 	return 0;
 }
@@ -198,7 +198,7 @@ int team_parse_setup(json_t *jsetup, struct if_entry *entry, json_error_t *jerr)
 	if (json_unpack_ex(jsetup, jerr, 0, "{s:s}", "runner_name", &runner_name))
 		return -1;
 
-	if_add_config(entry, "runner", "%s", runner_name);
+	if_add_config(entry, "runner", str, runner_name);
 	return 0;
 }
 
@@ -305,26 +305,16 @@ static int team_post(struct if_entry *master, _unused struct list *netns_list)
 {
 	struct team_priv *priv = master->handler_private;
 	struct if_entry *slave;
-	const char *active_name;
 
 	if (!master->active_slave && priv->active_port_name) {
-		active_name = json_string_value(priv->active_port_name);
 		list_for_each_member(slave, master->rev_master, rev_master_node) {
-			if (strcmp(slave->if_name, active_name)) {
+			if (strcmp(slave->if_name, priv->active_port_name)) {
 				slave->flags |= IF_PASSIVE_SLAVE;
 			} else {
 				master->active_slave = slave;
-				if_add_state(master, "active port", "%s", slave->if_name);
+				if_add_state(master, "active port", iface, slave);
 			}
 		}
 	}
 	return 0;
 }
-
-static void team_cleanup(struct if_entry *entry)
-{
-	struct team_priv *priv = entry->handler_private;
-
-	if (priv->active_port_name)
-		json_decref(priv->active_port_name);
-}
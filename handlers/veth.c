@@ -15,12 +15,12 @@
 
 #include "veth.h"
 #include <errno.h>
-#include <string.h>
 #include "../ethtool.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../master.h"
 #include "../match.h"
+#include "../netns.h"
 
 struct netns_entry;
 
@@ -28,6 +28,7 @@ static int veth_scan(struct if_entry *entry);
 static int veth_post(struct if_entry *entry, struct list *netns_list);
 
 static struct if_handler h_veth = {
+	.name = "veth",
 	.driver = "veth",
 	.scan = veth_scan,
 	.post = veth_post,
@@ -40,13 +41,15 @@ void handler_veth_register(void)
 
 static int veth_scan(struct if_entry *entry)
 {
+	int fd;
+
 	if (entry->link_index) {
 		entry->peer_index = entry->link_index;
 		entry->peer_netnsid = entry->link_netnsid;
 		entry->link_index = 0;
 		entry->link_netnsid = -1;
-	} else {
-		entry->peer_index = ethtool_veth_peer(entry->if_name);
+	} else if (!netns_ioctl_sock(entry->ns, &fd)) {
+		entry->peer_index = ethtool_veth_peer(fd, entry->if_name);
 	}
 	return 0;
 }
@@ -57,7 +60,7 @@ static int match_peer(struct if_entry *entry, void *arg)
 
 	if (entry->if_index != link->peer_index ||
 	    entry->peer_index != link->if_index ||
-	    strcmp(entry->driver, "veth"))
+	    entry->driver != h_veth.driver)
 		return 0;
 	if (entry->peer && entry->peer != link)
 		return 0;
@@ -79,6 +82,7 @@ static int veth_post(struct if_entry *entry, struct list *netns_list)
 	match_init(&match);
 	match.netns_list = netns_list;
 	match.exclude = entry;
+	match_by_ifindex(&match, entry->peer_index);
 
 	if ((err = match_if(&match, match_peer, entry)))
 		return err;
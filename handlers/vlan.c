@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include "../arena.h"
 #include "../handler.h"
 #include "../if.h"
 #include "../netlink.h"
@@ -29,6 +30,7 @@ struct vlan_private {
 static int vlan_netlink(struct if_entry *entry, struct nlattr **linkinfo);
 
 static struct if_handler h_vlan = {
+	.name = "vlan",
 	.driver = "802.1Q VLAN Support",
 	.private_size = sizeof(struct vlan_private),
 	.netlink = vlan_netlink,
@@ -39,27 +41,24 @@ void handler_vlan_register(void)
 	if_handler_register(&h_vlan);
 }
 
+static const struct nla_policy vlan_policy[IFLA_VLAN_MAX + 1] = {
+	[IFLA_VLAN_ID]	= { .min_len = sizeof(uint16_t) },
+};
+
 static int vlan_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 {
 	struct vlan_private *priv = entry->handler_private;
-	struct nlattr **vlanattr;
-	int err = 0;
+	struct nlattr *vlanattr[IFLA_VLAN_MAX + 1];
 
 	if (!linkinfo || !linkinfo[IFLA_INFO_DATA])
 		return ENOENT;
-	vlanattr = nla_nested_attrs(linkinfo[IFLA_INFO_DATA], IFLA_VLAN_MAX);
-	if (!vlanattr)
-		return ENOMEM;
-	if (!vlanattr[IFLA_VLAN_ID]) {
-		err = ENOENT;
-		goto out;
-	}
+	nla_parse_nested(vlanattr, IFLA_VLAN_MAX, linkinfo[IFLA_INFO_DATA],
+			 vlan_policy);
+	if (!vlanattr[IFLA_VLAN_ID])
+		return ENOENT;
 	priv->tag = nla_read_u16(vlanattr[IFLA_VLAN_ID]);
-	if (asprintf(&entry->edge_label, "tag %d", priv->tag) < 0) {
-		err = ENOMEM;
-		goto out;
-	}
-out:
-	free(vlanattr);
-	return err;
+	entry->edge_label = arena_printf(if_arena(entry), "tag %d", priv->tag);
+	if (!entry->edge_label)
+		return ENOMEM;
+	return 0;
 }
@@ -31,8 +31,8 @@
 #define VXLAN_DEFAULT_PORT 46354
 
 struct vxlan_priv {
-	struct addr *local;
-	struct addr *group;
+	struct addr local;
+	struct addr group;
 	int flags;
 };
 
@@ -40,6 +40,7 @@ static int vxlan_netlink(struct if_entry *entry, struct nlattr **linkinfo);
 static int vxlan_post(struct if_entry *entry, struct list *netns_list);
 
 static struct if_handler h_vxlan = {
+	.name = "vxlan",
 	.driver = "vxlan",
 	.private_size = sizeof(struct vxlan_priv),
 	.netlink = vxlan_netlink,
@@ -48,62 +49,49 @@ static struct if_handler h_vxlan = {
 
 #define VXLAN_COLLECT_METADATA 1
 
+static const struct nla_policy vxlan_policy[IFLA_VXLAN_MAX + 1] = {
+	[IFLA_VXLAN_ID]			= { .min_len = sizeof(uint32_t) },
+	[IFLA_VXLAN_GROUP]		= { .min_len = 4 },
+	[IFLA_VXLAN_LOCAL]		= { .min_len = 4 },
+	[IFLA_VXLAN_PORT]		= { .min_len = sizeof(uint16_t) },
+	[IFLA_VXLAN_GROUP6]		= { .min_len = 16 },
+	[IFLA_VXLAN_LOCAL6]		= { .min_len = 16 },
+	[IFLA_VXLAN_COLLECT_METADATA]	= { .min_len = sizeof(uint8_t) },
+};
+
 void handler_vxlan_register(void)
 {
 	if_handler_register(&h_vxlan);
 }
 
-static int vxlan_fill_addr(struct addr **addr, int ai_family, struct nlattr *attr)
+static int vxlan_fill_addr(struct addr *addr, int ai_family,
+			   struct nlattr *attr)
 {
-	int err;
-
-	if (!attr || *addr)
+	if (!attr || addr->family)
 		return 0;
-
-	*addr = calloc(1, sizeof(struct addr));
-	if (!*addr)
-		return ENOMEM;
-
-	if ((err = addr_init(*addr, ai_family, addr_max_prefix_len(ai_family), nla_read(attr)))) {
-		free(*addr);
-		*addr = NULL;
-		return err;
-	}
-
-	return 0;
+	return addr_init_nla(addr, ai_family, addr_max_prefix_len(ai_family),
+			     attr);
 }
 
 static int vxlan_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 {
-	struct nlattr **vxlaninfo;
+	struct vxlan_priv *priv = entry->handler_private;
+	struct nlattr *vxlaninfo[IFLA_VXLAN_MAX + 1];
 	uint16_t port;
-	struct vxlan_priv *priv;
 	int err;
 
-	priv = calloc(1, sizeof(struct vxlan_priv));
-	if (!priv) {
-		err = ENOMEM;
-		goto err;
-	}
-	entry->handler_private = priv;
-
-	if (!linkinfo || !linkinfo[IFLA_INFO_DATA]) {
-		err = ENOENT;
-		goto err_priv;
-	}
-	vxlaninfo = nla_nested_attrs(linkinfo[IFLA_INFO_DATA], IFLA_VXLAN_MAX);
-	if (!vxlaninfo) {
-		err = ENOMEM;
-		goto err_priv;
-	}
+	if (!linkinfo || !linkinfo[IFLA_INFO_DATA])
+		return ENOENT;
+	nla_parse_nested(vxlaninfo, IFLA_VXLAN_MAX, linkinfo[IFLA_INFO_DATA],
+			 vxlan_policy);
 
 	if (vxlaninfo[IFLA_VXLAN_ID])
-		if_add_config(entry, "VNI", "%u", nla_read_u32(vxlaninfo[IFLA_VXLAN_ID]));
+		if_add_config(entry, "VNI", int, nla_read_u32(vxlaninfo[IFLA_VXLAN_ID]));
 
 	if (vxlaninfo[IFLA_VXLAN_PORT]) {
 		port = nla_read_u16(vxlaninfo[IFLA_VXLAN_PORT]);
 		if (port != VXLAN_DEFAULT_PORT)
-			if_add_config(entry, "port", "%u", port);
+			if_add_config(entry, "port", int, port);
 	}
 
 	if (vxlaninfo[IFLA_VXLAN_COLLECT_METADATA]) {
@@ -111,28 +99,20 @@ static int vxlan_netlink(struct if_entry *entry, struct nlattr **linkinfo)
 	}
 
 	if (priv->flags & VXLAN_COLLECT_METADATA) {
-		if_add_config(entry, "mode", "external");
+		if_add_config(entry, "mode", str, "external");
 	} else {
 		/* These can be set in COLLECT_METADATA, but are ignored by kernel */
 		if ((err = vxlan_fill_addr(&priv->group, AF_INET, vxlaninfo[IFLA_VXLAN_GROUP])))
-			goto err_attrs;
+			return err;
 		if ((err = vxlan_fill_addr(&priv->group, AF_INET6, vxlaninfo[IFLA_VXLAN_GROUP6])))
-			goto err_attrs;
+			return err;
 		if ((err = vxlan_fill_addr(&priv->local, AF_INET, vxlaninfo[IFLA_VXLAN_LOCAL])))
-			goto err_attrs;
+			return err;
 		if ((err = vxlan_fill_addr(&priv->local, AF_INET6, vxlaninfo[IFLA_VXLAN_LOCAL6])))
-			goto err_attrs;
+			return err;
 	}
 
-	free(vxlaninfo);
 	return 0;
-
-err_attrs:
-	free(vxlaninfo);
-err_priv:
-	free(priv);
-err:
-	return err;
 }
 
 static int vxlan_post(struct if_entry *entry, _unused struct list *netns_list)
@@ -141,14 +121,14 @@ static int vxlan_post(struct if_entry *entry, _unused struct list *netns_list)
 	struct if_entry *ife;
 
 	priv = (struct vxlan_priv *) entry->handler_private;
-	if (priv->local) {
-		if_add_config(entry, "from", "%s", priv->local->formatted);
-		if ((ife = tunnel_find_addr(entry->ns, priv->local))) {
+	if (priv->local.family) {
+		if_add_config(entry, "from", addr, &priv->local);
+		if ((ife = tunnel_find_addr(entry->ns, &priv->local))) {
 			link_set(ife, entry);
 			entry->flags |= IF_LINK_WEAK;
 		}
 	}
-	if (priv->group)
-		if_add_config(entry, "to", "%s", priv->group->formatted);
+	if (priv->group.family)
+		if_add_config(entry, "to", addr, &priv->group);
 	return 0;
 }
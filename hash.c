@@ -0,0 +1,137 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "hash.h"
+#include <errno.h>
+#include <stdlib.h>
+
+#define HASH_MIN_SIZE	16
+
+static int hash_resize(struct hash_table *table, unsigned int size)
+{
+	struct hash_node **buckets, *n, *next;
+	unsigned int i;
+
+	buckets = calloc(size, sizeof(*buckets));
+	if (!buckets)
+		return ENOMEM;
+	for (i = 0; i < table->size; i++) {
+		for (n = table->buckets[i]; n; n = next) {
+			next = n->next;
+			n->next = buckets[n->hash & (size - 1)];
+			buckets[n->hash & (size - 1)] = n;
+		}
+	}
+	free(table->buckets);
+	table->buckets = buckets;
+	table->size = size;
+	return 0;
+}
+
+int hash_add(struct hash_table *table, struct hash_node *n, unsigned int hash)
+{
+	struct hash_node **bucket;
+	int err;
+
+	if (table->count >= table->size) {
+		err = hash_resize(table, table->size ? table->size * 2 : HASH_MIN_SIZE);
+		if (err)
+			return err;
+	}
+	n->hash = hash;
+	bucket = &table->buckets[hash & (table->size - 1)];
+	n->next = *bucket;
+	*bucket = n;
+	table->count++;
+	return 0;
+}
+
+void hash_remove(struct hash_table *table, struct hash_node *n)
+{
+	struct hash_node **ptr;
+
+	for (ptr = &table->buckets[n->hash & (table->size - 1)]; *ptr; ptr = &(*ptr)->next) {
+		if (*ptr == n) {
+			*ptr = n->next;
+			n->next = NULL;
+			table->count--;
+			return;
+		}
+	}
+}
+
+void hash_free(struct hash_table *table, destruct_f destruct)
+{
+	struct hash_node *n, *next;
+	unsigned int i;
+
+	for (i = 0; i < table->size; i++) {
+		for (n = table->buckets[i]; n; n = next) {
+			next = n->next;
+			if (destruct)
+				destruct(n);
+			free(n);
+		}
+	}
+	free(table->buckets);
+	hash_init(table);
+}
+
+void hash_clear(struct hash_table *table)
+{
+	free(table->buckets);
+	hash_init(table);
+}
+
+/* The finalizer of MurmurHash3, spreads the entropy to the low bits that
+ * are used for bucket selection. */
+unsigned int hash_u32(uint32_t val)
+{
+	val ^= val >> 16;
+	val *= 0x85ebca6b;
+	val ^= val >> 13;
+	val *= 0xc2b2ae35;
+	val ^= val >> 16;
+	return val;
+}
+
+unsigned int hash_u64(uint64_t val)
+{
+	return hash_u32(val ^ (val >> 32));
+}
+
+/* FNV-1a */
+unsigned int hash_mem(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint32_t h = 2166136261u;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 16777619;
+	}
+	return hash_u32(h);
+}
+
+unsigned int hash_str(const char *str)
+{
+	uint32_t h = 2166136261u;
+
+	while (*str) {
+		h ^= (unsigned char)*str++;
+		h *= 16777619;
+	}
+	return hash_u32(h);
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "list.h"
+
+/*
+ * Chained hash table. Similarly to lists, insert the hash_node as the first
+ * member of a structure to store the structure in a hash table. The table
+ * does not know about keys; the user supplies the hash value when adding
+ * and looking up, and compares the keys of the matching entries.
+ *
+ * A zeroed table is a valid empty table, buckets are allocated on the
+ * first insertion. The table grows automatically.
+ */
+struct hash_node {
+	struct hash_node *next;
+	unsigned int hash;
+};
+
+struct hash_table {
+	struct hash_node **buckets;
+	unsigned int size;
+	unsigned int count;
+};
+
+#define HASH_INITIALIZER	{ .buckets = NULL, .size = 0, .count = 0 }
+
+#define __hash_bucket(table, h)						\
+	((table).size ? (void *)(table).buckets[(h) & ((table).size - 1)] : NULL)
+
+/*
+ * Iterates over entries with the given hash value. The keys still need to
+ * be compared, different keys may have the same hash value.
+ */
+#define hash_for_each_match(n, table, h)				\
+	for (n = __hash_bucket(table, h); n;				\
+	     n = (void *)((struct hash_node *)(n))->next)		\
+		if (((struct hash_node *)(n))->hash == (h))
+
+#define hash_for_each(n, table, i)					\
+	for (i = 0; i < (table).size; i++)				\
+		for (n = (void *)(table).buckets[i]; n;			\
+		     n = (void *)((struct hash_node *)(n))->next)
+
+static inline void hash_init(struct hash_table *table)
+{
+	table->buckets = NULL;
+	table->size = table->count = 0;
+}
+
+int hash_add(struct hash_table *table, struct hash_node *n, unsigned int hash);
+void hash_remove(struct hash_table *table, struct hash_node *n);
+/* Frees all the entries (calling destruct on them first, if not NULL) and
+ * the table itself. The table is left empty and can be reused. */
+void hash_free(struct hash_table *table, destruct_f destruct);
+/* Frees the table but not the entries, for entries allocated from an
+ * arena. The table is left empty and can be reused. */
+void hash_clear(struct hash_table *table);
+
+unsigned int hash_u32(uint32_t val);
+unsigned int hash_u64(uint64_t val);
+unsigned int hash_mem(const void *buf, size_t len);
+unsigned int hash_str(const char *str);
+
+#endif
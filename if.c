@@ -17,14 +17,18 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <net/if.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include "arena.h"
 #include "ethtool.h"
 #include "handler.h"
+#include "hash.h"
+#include "intern.h"
 #include "label.h"
 #include "list.h"
 #include "netlink.h"
@@ -33,10 +37,126 @@
 
 #include "compat.h"
 
+/* links queried at once when reconciling an interrupted dump */
+#define IF_RECONCILE_BATCH	64
+
+static const struct nla_policy ifla_policy[IFLA_MAX + 1] = {
+	[IFLA_IFNAME]		= { .min_len = 1 },
+	[IFLA_MASTER]		= { .min_len = sizeof(uint32_t) },
+	[IFLA_LINK]		= { .min_len = sizeof(uint32_t) },
+	[IFLA_LINK_NETNSID]	= { .min_len = sizeof(int32_t) },
+	[IFLA_MTU]		= { .min_len = sizeof(uint32_t) },
+};
+
+static const struct nla_policy ifla_info_policy[IFLA_INFO_MAX + 1] = {
+	[IFLA_INFO_KIND]	= { .min_len = 1 },
+};
+
+static const struct nla_policy ifa_policy[IFA_MAX + 1] = {
+	[IFA_ADDRESS]		= { .min_len = 4 },
+	[IFA_LOCAL]		= { .min_len = 4 },
+};
+
+/* The driver of a link kind is given by the kernel module implementing
+ * it, not by the name space. The cache is thus global. */
+struct if_driver {
+	struct hash_node n;
+	/* interned */
+	const char *kind;
+	const char *driver;
+};
+
+static struct hash_table driver_cache;
+/* the entries are never freed one by one */
+static struct arena driver_arena;
+static pthread_mutex_t driver_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Leaves the driver unset if ethtool does not know it. */
+static int if_driver_ethtool(struct if_entry *dest)
+{
+	char *driver;
+	int fd;
+
+	if (netns_ioctl_sock(dest->ns, &fd))
+		return 0;
+	driver = ethtool_driver(fd, dest->if_name);
+	if (!driver)
+		return 0;
+	dest->driver = intern(driver);
+	free(driver);
+	return dest->driver ? 0 : ENOMEM;
+}
+
+/* Must be called with driver_lock held. */
+static const char *if_driver_cached(const char *kind, unsigned int h)
+{
+	struct if_driver *ptr;
+
+	hash_for_each_match(ptr, driver_cache, h)
+		if (ptr->kind == kind)
+			return ptr->driver;
+	return NULL;
+}
+
+/* All links of the same kind have the same driver; ethtool is asked until
+ * it answers for a link of the kind. Links without kind (i.e. physical
+ * devices) are always asked. The lock is not held while asking, another
+ * thread may ask for the same kind meanwhile; the first answer wins. If
+ * ethtool fails, the kind is used as the driver of this link only, the
+ * failure may be specific to the link (e.g. it disappeared). */
+static int if_driver_by_kind(struct if_entry *dest, const char *kind_str)
+{
+	struct if_driver *ptr;
+	const char *kind;
+	unsigned int h;
+	int err = 0;
+
+	kind = intern(kind_str);
+	if (!kind)
+		return ENOMEM;
+	h = hash_u64((uintptr_t)kind);
+
+	pthread_mutex_lock(&driver_lock);
+	dest->driver = if_driver_cached(kind, h);
+	pthread_mutex_unlock(&driver_lock);
+	if (dest->driver)
+		return 0;
+
+	if ((err = if_driver_ethtool(dest)))
+		return err;
+	if (!dest->driver) {
+		/* no ethtool ops available, use the kind */
+		dest->driver = kind;
+		return 0;
+	}
+
+	pthread_mutex_lock(&driver_lock);
+	if (if_driver_cached(kind, h))
+		goto out;
+	ptr = arena_alloc(&driver_arena, sizeof(*ptr));
+	if (!ptr) {
+		err = ENOMEM;
+		goto out;
+	}
+	ptr->kind = kind;
+	ptr->driver = dest->driver;
+	err = hash_add(&driver_cache, &ptr->n, h);
+out:
+	pthread_mutex_unlock(&driver_lock);
+	return err;
+}
+
+void if_cleanup(void)
+{
+	hash_clear(&driver_cache);
+	arena_free(&driver_arena);
+}
+
 static int fill_if_link(struct if_entry *dest, struct nlmsg *msg)
 {
+	struct nlattr *tb[IFLA_MAX + 1], *linkinfo_tb[IFLA_INFO_MAX + 1];
+	struct nlattr **linkinfo = NULL;
 	struct ifinfomsg *ifi;
-	struct nlattr **tb, **linkinfo = NULL;
 	int err;
 
 	if (nlmsg_get_hdr(msg)->nlmsg_type != RTM_NEWLINK)
@@ -44,19 +164,13 @@ static int fill_if_link(struct if_entry *dest, struct nlmsg *msg)
 	ifi = nlmsg_get(msg, sizeof(*ifi));
 	if (!ifi)
 		return ENOENT;
-	tb = nlmsg_attrs(msg, IFLA_MAX);
-	if (!tb)
-		return ENOMEM;
-	if (!tb[IFLA_IFNAME]) {
-		err = ENOENT;
-		goto out;
-	}
+	nlmsg_parse(msg, tb, IFLA_MAX, ifla_policy);
+	if (!tb[IFLA_IFNAME])
+		return ENOENT;
 	dest->if_index = ifi->ifi_index;
-	dest->if_name = strdup(nla_read_str(tb[IFLA_IFNAME]));
-	if (!dest->if_name) {
-		err = ENOMEM;
-		goto err_ifname;
-	}
+	dest->if_name = arena_strdup(if_arena(dest), nla_read_str(tb[IFLA_IFNAME]));
+	if (!dest->if_name)
+		return ENOMEM;
 	if (ifi->ifi_flags & IFF_UP) {
 		dest->flags |= IF_UP;
 		if (ifi->ifi_flags & IFF_RUNNING)
@@ -72,126 +186,91 @@ static int fill_if_link(struct if_entry *dest, struct nlmsg *msg)
 	if (tb[IFLA_MTU])
 		dest->mtu = nla_read_u32(tb[IFLA_MTU]);
 	if (tb[IFLA_LINKINFO]) {
-		linkinfo = nla_nested_attrs(tb[IFLA_LINKINFO], IFLA_INFO_MAX);
-		if (!linkinfo) {
-			err = ENOMEM;
-			goto err_ifname;
-		}
+		nla_parse_nested(linkinfo_tb, IFLA_INFO_MAX, tb[IFLA_LINKINFO],
+				 ifla_info_policy);
+		linkinfo = linkinfo_tb;
 	}
 
-	if (tb[IFLA_ADDRESS]) {
-		err = mac_addr_fill_netlink(&dest->mac_addr, tb[IFLA_ADDRESS]);
-		if (err)
-			goto err_ifname;
-	}
+	if (tb[IFLA_ADDRESS])
+		mac_addr_fill_netlink(&dest->mac_addr, tb[IFLA_ADDRESS]);
 
 	if (ifi->ifi_flags & IFF_LOOPBACK) {
-		dest->driver = strdup("loopback");
+		dest->driver = intern("loopback");
 		dest->flags |= IF_LOOPBACK;
-	} else
-		dest->driver = ethtool_driver(dest->if_name);
-	if (!dest->driver) {
-		/* No ethtool ops available, try IFLA_INFO_KIND */
-		if (tb[IFLA_LINKINFO] && linkinfo && linkinfo[IFLA_INFO_KIND])
-			dest->driver = strdup(RTA_DATA(linkinfo[IFLA_INFO_KIND]));
+		err = dest->driver ? 0 : ENOMEM;
+	} else if (linkinfo && linkinfo[IFLA_INFO_KIND]) {
+		err = if_driver_by_kind(dest, nla_read_str(linkinfo[IFLA_INFO_KIND]));
+	} else {
+		err = if_driver_ethtool(dest);
 	}
+	if (err)
+		return err;
 	if (!dest->driver) {
 		/* Allow the program to continue at least with generic stuff
 		 * as there may be interfaces that do not implement any of
 		 * the mechanisms for driver detection that we use */
-		dest->driver = strdup("unknown driver, please report a bug");
+		dest->driver = intern("unknown driver, please report a bug");
+		if (!dest->driver)
+			return ENOMEM;
 	}
 
 	if ((err = if_handler_init(dest)))
-		goto err_driver;
+		return err;
 
 	if ((err = if_handler_netlink(dest, linkinfo)))
 		if (err != ENOENT)
-			goto err_driver;
-
-	err = 0;
-	goto out;
+			return err;
 
-err_driver:
-	free(dest->driver);
-	dest->driver = NULL;
-err_ifname:
-	free(dest->if_name);
-	dest->if_name = NULL;
-out:
-	free(tb);
-	free(linkinfo);
-	return err;
+	return 0;
 }
 
-static int fill_if_addr(struct if_entry *dest, struct nlmsg *alist)
+static int fill_if_addr(struct if_entry *dest, struct nlmsg *ainfo,
+			struct ifaddrmsg *ifa)
 {
+	struct nlattr *rta_tb[IFA_MAX + 1];
 	struct if_addr *entry;
-	struct ifaddrmsg *ifa;
-	struct nlattr **rta_tb;
 	int err;
 
-	for_each_nlmsg(ainfo, alist) {
-		rta_tb = NULL;
-		err = 0;
-		ifa = nlmsg_get(ainfo, sizeof(*ifa));
-		if (!ifa)
-			return ENOENT;
-		if (ifa->ifa_index != dest->if_index)
-			goto skip;
-		if (nlmsg_get_hdr(ainfo)->nlmsg_type != RTM_NEWADDR)
-			goto skip;
-		if (ifa->ifa_family != AF_INET &&
-		    ifa->ifa_family != AF_INET6)
-			/* only IP addresses supported (at least for now) */
-			goto skip;
-		rta_tb = nlmsg_attrs(ainfo, IFA_MAX);
-		if (!rta_tb) {
-			err = ENOMEM;
-			goto skip;
-		}
-		if (!rta_tb[IFA_LOCAL] && !rta_tb[IFA_ADDRESS])
-			/* don't care about broadcast and anycast adresses */
-			goto skip;
-
-		entry = calloc(1, sizeof(struct if_addr));
-		if (!entry) {
-			err = ENOMEM;
-			goto skip;
-		}
+	if (nlmsg_get_hdr(ainfo)->nlmsg_type != RTM_NEWADDR)
+		return 0;
+	if (ifa->ifa_family != AF_INET &&
+	    ifa->ifa_family != AF_INET6)
+		/* only IP addresses supported (at least for now) */
+		return 0;
+	nlmsg_parse(ainfo, rta_tb, IFA_MAX, ifa_policy);
+	if (!rta_tb[IFA_LOCAL] && !rta_tb[IFA_ADDRESS])
+		/* don't care about broadcast and anycast adresses */
+		return 0;
 
-		list_append(&dest->addr, node(entry));
+	entry = arena_alloc(if_arena(dest), sizeof(struct if_addr));
+	if (!entry)
+		return ENOMEM;
 
-		if (!rta_tb[IFA_LOCAL]) {
-			rta_tb[IFA_LOCAL] = rta_tb[IFA_ADDRESS];
-			rta_tb[IFA_ADDRESS] = NULL;
-		}
-		if ((err = addr_init_netlink(&entry->addr, ifa, rta_tb[IFA_LOCAL])))
-			goto skip;
-		if (rta_tb[IFA_ADDRESS] &&
-		    memcmp(nla_read(rta_tb[IFA_ADDRESS]), nla_read(rta_tb[IFA_LOCAL]),
-			   ifa->ifa_family == AF_INET ? 4 : 16)) {
-			if ((err = addr_init_netlink(&entry->peer, ifa, rta_tb[IFA_ADDRESS])))
-				goto skip;
-		}
-skip:
-		nlmsg_unget(ainfo, sizeof(*ifa));
-		if (rta_tb)
-			free(rta_tb);
-		if (err)
-			return err;
+	list_append(&dest->addr, node(entry));
+
+	if (!rta_tb[IFA_LOCAL]) {
+		rta_tb[IFA_LOCAL] = rta_tb[IFA_ADDRESS];
+		rta_tb[IFA_ADDRESS] = NULL;
 	}
+	if ((err = addr_init_netlink(&entry->addr, ifa, rta_tb[IFA_LOCAL])))
+		return err;
+	if (rta_tb[IFA_ADDRESS] &&
+	    nla_len(rta_tb[IFA_ADDRESS]) == nla_len(rta_tb[IFA_LOCAL]) &&
+	    memcmp(nla_read(rta_tb[IFA_ADDRESS]), nla_read(rta_tb[IFA_LOCAL]),
+		   nla_len(rta_tb[IFA_LOCAL])))
+		return addr_init_netlink(&entry->peer, ifa, rta_tb[IFA_ADDRESS]);
 	return 0;
 }
 
-struct if_entry *if_create(void)
+struct if_entry *if_create(struct netns_entry *ns)
 {
 	struct if_entry *entry;
 
-	entry = calloc(1, sizeof(struct if_entry));
+	entry = arena_alloc(&ns->arena, sizeof(struct if_entry));
 	if (!entry)
 		return NULL;
 
+	entry->ns = ns;
 	list_init(&entry->addr);
 	list_init(&entry->rev_master);
 	list_init(&entry->rev_link);
@@ -202,70 +281,271 @@ struct if_entry *if_create(void)
 	return entry;
 }
 
-int if_list(struct list *result, struct netns_entry *ns)
+struct arena *if_arena(struct if_entry *entry)
 {
-	struct nl_handle hnd;
-	struct nlmsg *linfo, *ainfo;
+	return &entry->ns->arena;
+}
+
+struct if_list_scan {
+	struct list *result;
+	struct netns_entry *ns;
+};
+
+/* an entry of netns_entry->if_index */
+struct if_index_entry {
+	struct hash_node n;
 	struct if_entry *entry;
-	int err;
+};
 
-	list_init(result);
+struct if_entry *if_find_index(struct netns_entry *ns, unsigned int ifindex)
+{
+	struct if_index_entry *ptr;
+
+	hash_for_each_match(ptr, ns->if_index, hash_u32(ifindex))
+		if (ptr->entry->if_index == ifindex)
+			return ptr->entry;
+	return NULL;
+}
 
-	if ((err = rtnl_open(&hnd)))
+static int if_list_link(struct nlmsg *msg, void *arg)
+{
+	struct if_list_scan *scan = arg;
+	struct if_index_entry *ptr;
+	struct if_entry *entry;
+	int err;
+
+	entry = if_create(scan->ns);
+	if (!entry)
+		return ENOMEM;
+	list_append(scan->result, node(entry));
+	if ((err = fill_if_link(entry, msg)))
 		return err;
-	err = rtnl_ifi_dump(&hnd, RTM_GETLINK, AF_UNSPEC, &linfo);
-	if (err)
-		goto out_close;
-	err = rtnl_ifi_dump(&hnd, RTM_GETADDR, AF_UNSPEC, &ainfo);
-	if (err)
-		goto out_linfo;
+	ptr = arena_alloc(&scan->ns->arena, sizeof(*ptr));
+	if (!ptr)
+		return ENOMEM;
+	ptr->entry = entry;
+	return hash_add(&scan->ns->if_index, &ptr->n, hash_u32(entry->if_index));
+}
+
+/* The memory of the dropped entries stays in the arena until the name
+ * space is freed. The number of restarts is limited. */
+static void if_list_link_restart(void *arg)
+{
+	struct if_list_scan *scan = arg;
+
+	hash_clear(&scan->ns->if_index);
+	if_list_free(scan->result);
+}
+
+static int if_list_addr(struct nlmsg *msg, void *arg)
+{
+	struct if_list_scan *scan = arg;
+	struct if_entry *entry;
+	struct ifaddrmsg *ifa;
+
+	ifa = nlmsg_get(msg, sizeof(*ifa));
+	if (!ifa)
+		return ENOENT;
+	entry = if_find_index(scan->ns, ifa->ifa_index);
+	if (!entry)
+		return 0;
+	return fill_if_addr(entry, msg, ifa);
+}
 
-	for_each_nlmsg(l, linfo) {
-		entry = if_create();
-		if (!entry) {
-			err = ENOMEM;
-			goto out_ainfo;
+static void if_list_addr_restart(void *arg)
+{
+	struct if_list_scan *scan = arg;
+	struct if_entry *entry;
+
+	list_for_each(entry, *scan->result)
+		list_init(&entry->addr);
+}
+
+static int if_index_cmp(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int if_list_link_batch(struct if_list_scan *scan, struct nl_handle *hnd,
+			      unsigned int *index, int count)
+{
+	struct nlmsg *req[IF_RECONCILE_BATCH], *resp[IF_RECONCILE_BATCH];
+	unsigned int ext_mask = if_handler_link_ext();
+	int i, err = 0;
+
+	for (i = 0; i < count; i++) {
+		req[i] = rtnl_link_req(index[i], ext_mask);
+		if (!req[i]) {
+			while (i--)
+				nlmsg_free(req[i]);
+			return ENOMEM;
+		}
+	}
+	if (!(err = nl_exchange_many(hnd, req, resp, count))) {
+		for (i = 0; i < count; i++) {
+			/* no reply means the link is gone */
+			if (resp[i] && !err)
+				err = if_list_link(resp[i], scan);
+			nlmsg_free(resp[i]);
 		}
-		list_append(result, node(entry));
-		entry->ns = ns;
-		if ((err = fill_if_link(entry, l)))
-			goto out_ainfo;
-		if ((err = fill_if_addr(entry, ainfo)))
-			goto out_ainfo;
-		if ((err = if_handler_scan(entry)))
-			goto out_ainfo;
 	}
-	err = 0;
-
-out_ainfo:
-	nlmsg_free(ainfo);
-out_linfo:
-	nlmsg_free(linfo);
-out_close:
-	nl_close(&hnd);
+	for (i = 0; i < count; i++)
+		nlmsg_free(req[i]);
 	return err;
 }
 
-static void if_addr_destruct(struct if_addr *entry)
+/* The link dump was interrupted: the links found may be stale or
+ * duplicated. The kernel does not tell which links changed, thus all of
+ * them are queried again by ifindex, the ones that disappeared in the
+ * meantime are dropped. Links created during the dump are not picked up,
+ * they may be missing; the name space is marked as inconsistent. */
+static int if_list_reconcile_links(struct if_list_scan *scan, struct nl_handle *hnd)
 {
-	addr_destruct(&entry->addr);
-	addr_destruct(&entry->peer);
+	struct if_entry *entry;
+	unsigned int *index;
+	int count = 0, i, n, err = 0;
+
+	list_for_each(entry, *scan->result)
+		count++;
+	index = malloc((count ? count : 1) * sizeof(*index));
+	if (!index)
+		return ENOMEM;
+	count = 0;
+	list_for_each(entry, *scan->result)
+		index[count++] = entry->if_index;
+	qsort(index, count, sizeof(*index), if_index_cmp);
+	for (i = n = 0; i < count; i++)
+		if (!n || index[n - 1] != index[i])
+			index[n++] = index[i];
+
+	if_list_link_restart(scan);
+	for (i = 0; i < n && !err; i += IF_RECONCILE_BATCH)
+		err = if_list_link_batch(scan, hnd, index + i,
+					 n - i < IF_RECONCILE_BATCH ? n - i : IF_RECONCILE_BATCH);
+	free(index);
+	return err;
 }
 
-static void if_list_destruct(struct if_entry *entry)
+static int if_addr_one(struct nlmsg *msg, void *arg)
 {
-	if_handler_cleanup(entry);
-	free(entry->internal_ns);
-	free(entry->if_name);
-	free(entry->edge_label);
-	mac_addr_destruct(&entry->mac_addr);
-	label_free_property(&entry->properties);
-	list_free(&entry->addr, (destruct_f) if_addr_destruct);
+	struct if_entry *entry = arg;
+	struct ifaddrmsg *ifa;
+
+	ifa = nlmsg_get(msg, sizeof(*ifa));
+	if (!ifa)
+		return ENOENT;
+	if (ifa->ifa_index != entry->if_index)
+		return 0;
+	return fill_if_addr(entry, msg, ifa);
 }
 
+static void if_addr_one_restart(void *arg)
+{
+	struct if_entry *entry = arg;
+
+	list_init(&entry->addr);
+}
+
+/* The address dump was interrupted. With strict checking, the kernel
+ * dumps addresses of a single interface without walking all of them, the
+ * addresses are thus dumped again interface by interface. Otherwise, the
+ * full dump is repeated once. Either way, the result is accepted even if
+ * interrupted again. */
+static int if_list_reconcile_addrs(struct if_list_scan *scan, struct nl_handle *hnd)
+{
+	struct rtnl_filter filter = { .ifindex = 0 };
+	struct if_entry *entry;
+	int err;
+
+	if_list_addr_restart(scan);
+	if (!hnd->strict) {
+		err = rtnl_dump(hnd, RTM_GETADDR, AF_UNSPEC, NULL, if_list_addr,
+				if_list_addr_restart, scan);
+		return err == EINTR ? 0 : err;
+	}
+	list_for_each(entry, *scan->result) {
+		filter.ifindex = entry->if_index;
+		err = rtnl_dump(hnd, RTM_GETADDR, AF_UNSPEC, &filter, if_addr_one,
+				if_addr_one_restart, entry);
+		if (err && err != EINTR)
+			return err;
+	}
+	return 0;
+}
+
+/* Links are dumped first, then addresses are dumped and assigned to the
+ * links, looked up by ifindex; the messages are processed as they arrive,
+ * no dump is held in memory as a whole. Handlers scan the interfaces after
+ * that.
+ *
+ * A dump interrupted by a concurrent change is not restarted as a whole,
+ * which might never succeed on a busy host; the received objects are
+ * queried again instead (see if_list_reconcile_links and
+ * if_list_reconcile_addrs) and the name space is marked as
+ * inconsistent. */
+int if_list(struct list *result, struct netns_entry *ns)
+{
+	struct if_list_scan scan = {
+		.result = result,
+		.ns = ns,
+	};
+	struct rtnl_filter link_filter = {
+		.ext_mask = if_handler_link_ext(),
+	};
+	struct nl_handle *hnd;
+	struct if_entry *entry;
+	int err;
+
+	list_init(result);
+
+	if ((err = netns_rtnl(ns, &hnd)))
+		goto out;
+	if (ns->link_dump)
+		err = nl_dump_list(ns->link_dump, if_list_link, &scan);
+	else
+		err = rtnl_dump(hnd, RTM_GETLINK, AF_UNSPEC, &link_filter,
+				if_list_link, if_list_link_restart, &scan);
+	if (err == EINTR) {
+		ns->inconsistent = 1;
+		err = if_list_reconcile_links(&scan, hnd);
+	}
+	if (err)
+		goto out;
+	if (ns->addr_dump)
+		err = nl_dump_list(ns->addr_dump, if_list_addr, &scan);
+	else
+		err = rtnl_dump(hnd, RTM_GETADDR, AF_UNSPEC, NULL, if_list_addr,
+				if_list_addr_restart, &scan);
+	if (err == EINTR) {
+		ns->inconsistent = 1;
+		err = if_list_reconcile_addrs(&scan, hnd);
+	}
+	if (err)
+		goto out;
+
+	list_for_each(entry, *result)
+		if ((err = if_handler_scan(entry)))
+			goto out;
+
+out:
+	nlmsg_free(ns->link_dump);
+	nlmsg_free(ns->addr_dump);
+	ns->link_dump = ns->addr_dump = NULL;
+	return err;
+}
+
+/* Everything is allocated from the arena of the name space, only the
+ * handlers are given a chance to release their external resources. */
 void if_list_free(struct list *list)
 {
-	list_free(list, (destruct_f) if_list_destruct);
+	struct if_entry *entry;
+
+	if (if_handler_need_cleanup())
+		list_for_each(entry, *list)
+			if_handler_cleanup(entry);
+	list_init(list);
 }
 
 int if_add_warning(struct if_entry *entry, char *fmt, ...)
@@ -278,7 +558,8 @@ int if_add_warning(struct if_entry *entry, char *fmt, ...)
 	entry->warnings++;
 	if (vasprintf(&warn, fmt, ap) < 0)
 		goto out;
-	err = label_add(&entry->ns->warnings, "%s: %s", ifstr(entry), warn);
+	err = label_add(if_arena(entry), &entry->ns->warnings, "%s: %s",
+			ifstr(entry), warn);
 	free(warn);
 out:
 	va_end(ap);
@@ -20,6 +20,8 @@
 #include "label.h"
 #include "list.h"
 
+struct arena;
+struct if_handler;
 struct netns_entry;
 
 struct if_addr {
@@ -34,12 +36,14 @@ struct if_entry {
 	struct node rev_link_node;	/* in if_entry->rev_link   */
 
 	struct netns_entry *ns;
-	char *internal_ns;
+	/* interned, see intern.h */
+	const char *internal_ns;
 	unsigned int if_index;
 	unsigned int flags;
 	int mtu;
 	char *if_name;
-	char *driver;
+	/* interned, see intern.h */
+	const char *driver;
 	struct list properties;
 	unsigned int master_index;
 	struct if_entry *master;
@@ -53,6 +57,8 @@ struct if_entry {
 	struct list addr;
 	struct mac_addr mac_addr;
 	char *edge_label;
+	/* the driver specific handler, set by if_handler_init */
+	struct if_handler *handler;
 	void *handler_private;
 	int warnings;
 	/* reverse fields needed by some frontends: */
@@ -72,14 +78,24 @@ struct if_entry {
 
 int if_list(struct list *result, struct netns_entry *ns);
 void if_list_free(struct list *list);
-struct if_entry *if_create(void);
+/* The entry is allocated from the arena of ns and belongs to ns. */
+struct if_entry *if_create(struct netns_entry *ns);
+/* The arena of the name space of the interface. Memory allocated from it
+ * lives as long as the interface and must not be freed. */
+struct arena *if_arena(struct if_entry *entry);
+/* Finds the interface of the given ifindex in O(1), using an index filled
+ * by if_list. */
+struct if_entry *if_find_index(struct netns_entry *ns, unsigned int ifindex);
+/* Frees the global cache of drivers of link kinds. */
+void if_cleanup(void);
 
 int if_add_warning(struct if_entry *entry, char *fmt, ...);
 
 #define IF_PROP_STATE	1
 #define IF_PROP_CONFIG	2
 
-#define if_add_state(entry, key, fmt, ...) label_add_property(&(entry)->properties, IF_PROP_STATE, key, fmt, ##__VA_ARGS__)
-#define if_add_config(entry, key, fmt, ...) label_add_property(&(entry)->properties, IF_PROP_CONFIG, key, fmt, ##__VA_ARGS__)
+/* The kind is one of str, int, addr or iface, see label.h. */
+#define if_add_state(entry, key, kind, value) label_add_prop_##kind(if_arena(entry), &(entry)->properties, IF_PROP_STATE, key, value)
+#define if_add_config(entry, key, kind, value) label_add_prop_##kind(if_arena(entry), &(entry)->properties, IF_PROP_CONFIG, key, value)
 
 #endif
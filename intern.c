@@ -0,0 +1,58 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "intern.h"
+#include <pthread.h>
+#include <string.h>
+#include "arena.h"
+#include "hash.h"
+
+struct intern_entry {
+	struct hash_node n;
+	char str[];
+};
+
+static struct hash_table table;
+/* the entries are never freed one by one */
+static struct arena arena;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *intern(const char *s)
+{
+	unsigned int h = hash_str(s);
+	struct intern_entry *ptr;
+	size_t len;
+
+	pthread_mutex_lock(&lock);
+	hash_for_each_match(ptr, table, h)
+		if (!strcmp(ptr->str, s))
+			goto out;
+	len = strlen(s) + 1;
+	ptr = arena_alloc(&arena, sizeof(*ptr) + len);
+	if (!ptr)
+		goto out;
+	memcpy(ptr->str, s, len);
+	if (hash_add(&table, &ptr->n, h))
+		ptr = NULL;
+out:
+	pthread_mutex_unlock(&lock);
+	return ptr ? ptr->str : NULL;
+}
+
+void intern_cleanup(void)
+{
+	hash_clear(&table);
+	arena_free(&arena);
+}
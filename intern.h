@@ -0,0 +1,32 @@
+/*
+ * This file is a part of plotnetcfg, a tool to visualize network config.
+ * Copyright (C) 2017 Red Hat, Inc. -- Jiri Benc <jbenc@redhat.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _INTERN_H
+#define _INTERN_H
+
+/*
+ * Global table of interned strings, for strings repeated many times
+ * (driver names, property keys, name space ids). Interning returns the same
+ * pointer for equal strings; interned strings can be thus compared by
+ * pointer. The strings must not be modified and live until intern_cleanup.
+ *
+ * Thread safe.
+ */
+
+/* Returns NULL if out of memory. */
+const char *intern(const char *s);
+void intern_cleanup(void);
+
+#endif
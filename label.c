@@ -16,25 +16,23 @@
 #include "label.h"
 #include <errno.h>
 #include <stdarg.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include "arena.h"
+#include "intern.h"
 #include "list.h"
 
-int label_add(struct list *labels, char *fmt, ...)
+int label_add(struct arena *arena, struct list *labels, char *fmt, ...)
 {
 	va_list ap;
 	struct label *new;
 	int err = ENOMEM;
 
 	va_start(ap, fmt);
-	new = calloc(1, sizeof(*new));
+	new = arena_alloc(arena, sizeof(*new));
 	if (!new)
 		goto out;
-	if (vasprintf(&new->text, fmt, ap) < 0) {
-		free(new);
+	new->text = arena_vprintf(arena, fmt, ap);
+	if (!new->text)
 		goto out;
-	}
 
 	err = 0;
 	list_append(labels, node(new));
@@ -43,56 +41,73 @@ out:
 	return err;
 }
 
-static void label_destruct(struct label *item)
+static struct label_property *label_prop_new(struct arena *arena,
+					     struct list *properties, int type,
+					     const char *key,
+					     enum label_value_type value_type)
 {
-	free(item->text);
-}
+	struct label_property *new;
 
-void label_free(struct list *labels)
-{
-	list_free(labels, (destruct_f)label_destruct);
+	new = arena_alloc(arena, sizeof(*new));
+	if (!new)
+		return NULL;
+	new->key = intern(key);
+	if (!new->key)
+		return NULL;
+	new->type = type;
+	new->value_type = value_type;
+	list_append(properties, node(new));
+	return new;
 }
 
-int label_add_property(struct list *properties, int type,
-		       const char *key, const char *fmt, ...)
+int label_add_prop_str(struct arena *arena, struct list *properties, int type,
+		       const char *key, const char *value)
 {
-	va_list ap;
 	struct label_property *new;
-	int err = ENOMEM;
+	const char *str;
 
-	va_start(ap, fmt);
-	new = calloc(1, sizeof(*new));
+	str = intern(value);
+	if (!str)
+		return ENOMEM;
+	new = label_prop_new(arena, properties, type, key, LABEL_VALUE_STR);
 	if (!new)
-		goto out;
-
-	new->key = strdup(key);
-	if (!new->key)
-		goto out_new;
+		return ENOMEM;
+	new->value.str = str;
+	return 0;
+}
 
-	if (vasprintf(&new->value, fmt, ap) < 0) {
-		goto out_key;
-	}
+int label_add_prop_int(struct arena *arena, struct list *properties, int type,
+		       const char *key, long long value)
+{
+	struct label_property *new;
 
-	new->type = type;
-	list_append(properties, node(new));
+	new = label_prop_new(arena, properties, type, key, LABEL_VALUE_INT);
+	if (!new)
+		return ENOMEM;
+	new->value.num = value;
 	return 0;
-
-out_key:
-	free(new->key);
-out_new:
-	free(new);
-out:
-	va_end(ap);
-	return err;
 }
 
-static void label_property_destruct(struct label_property *prop)
+int label_add_prop_addr(struct arena *arena, struct list *properties, int type,
+			const char *key, const struct addr *value)
 {
-	free(prop->key);
-	free(prop->value);
+	struct label_property *new;
+
+	new = label_prop_new(arena, properties, type, key, LABEL_VALUE_ADDR);
+	if (!new)
+		return ENOMEM;
+	new->value.addr = *value;
+	return 0;
 }
 
-void label_free_property(struct list *properties)
+int label_add_prop_iface(struct arena *arena, struct list *properties, int type,
+			 const char *key, struct if_entry *value)
 {
-	list_free(properties, (destruct_f)label_property_destruct);
+	struct label_property *new;
+
+	new = label_prop_new(arena, properties, type, key, LABEL_VALUE_IFACE);
+	if (!new)
+		return ENOMEM;
+	new->value.iface = value;
+	return 0;
 }
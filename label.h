@@ -16,25 +16,51 @@
 #ifndef _LABEL_H
 #define _LABEL_H
 
+#include "addr.h"
 #include "list.h"
 
+struct arena;
+struct if_entry;
+
+/* Labels and properties are allocated from the given arena, there's no
+ * need to free them. */
 struct label {
 	struct node n;
 	char *text;
 };
 
+enum label_value_type {
+	LABEL_VALUE_STR,
+	LABEL_VALUE_INT,
+	LABEL_VALUE_ADDR,
+	LABEL_VALUE_IFACE,
+};
+
+/* The values are stored as they are and formatted only by the frontends.
+ * The key and string values are interned, see intern.h. */
 struct label_property {
 	struct node n;
 	int type;
-	char *key, *value;
+	enum label_value_type value_type;
+	const char *key;
+	union {
+		const char *str;
+		long long num;
+		struct addr addr;
+		struct if_entry *iface;
+	} value;
 };
 
-int label_add(struct list *labels, char *fmt, ...);
-void label_free(struct list *labels);
+int label_add(struct arena *arena, struct list *labels, char *fmt, ...);
 
-int label_add_property(struct list *properties, int type,
-		       const char *key, const char *fmt, ...);
-void label_free_property(struct list *properties);
+int label_add_prop_str(struct arena *arena, struct list *properties, int type,
+		       const char *key, const char *value);
+int label_add_prop_int(struct arena *arena, struct list *properties, int type,
+		       const char *key, long long value);
+int label_add_prop_addr(struct arena *arena, struct list *properties, int type,
+			const char *key, const struct addr *value);
+int label_add_prop_iface(struct arena *arena, struct list *properties, int type,
+			 const char *key, struct if_entry *value);
 #define label_prop_match_mask(type, mask) (((type) & (mask)) > 0)
 
 #endif
@@ -20,6 +20,9 @@
 #include <syscall.h>
 #include <unistd.h>
 #include "args.h"
+#include "capture.h"
+#include "if.h"
+#include "intern.h"
 #include "netns.h"
 #include "utils.h"
 #include "version.h"
@@ -49,6 +52,7 @@ static void register_frontends(void)
 
 static void register_handlers(void)
 {
+	handler_init();
 	handler_bond_register();
 	handler_bridge_register();
 	handler_gre_register();
@@ -106,12 +110,22 @@ int main(int argc, char **argv)
 	int netns_ok, err;
 
 	arg_register_batch(options, ARRAY_SIZE(options));
+	capture_init();
+	netns_init();
 	register_frontends();
 	register_handlers();
 	if ((err = arg_parse(argc, argv)))
 		exit(err);
+	if ((err = handler_setup())) {
+		fprintf(stderr, "Initialization failed: %s\n", strerror(err));
+		exit(1);
+	}
 
-	if (!check_caps()) {
+	if ((err = capture_start())) {
+		fprintf(stderr, "Cannot use the capture file: %s\n", strerror(err));
+		exit(1);
+	}
+	if (!capture_replaying() && !check_caps()) {
 		fprintf(stderr, "Must be run under root (or with enough capabilities).\n");
 		exit(1);
 	}
@@ -133,9 +147,18 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Invalid output format specified.\n");
 		exit(1);
 	}
+	handler_print_stats(stderr);
 	global_handler_cleanup(&netns_list);
 	netns_list_free(&netns_list);
+	netns_cleanup();
 	frontend_cleanup();
+	handler_cleanup();
+	if_cleanup();
+	intern_cleanup();
+	if ((err = capture_finish())) {
+		fprintf(stderr, "Cannot write the capture file: %s\n", strerror(err));
+		exit(1);
+	}
 
 	return 0;
 }
@@ -105,6 +105,7 @@ static int process(struct if_entry *entry, struct list *netns_list)
 		match_init(&match);
 		match.netns_list = netns_list;
 		match.exclude = entry;
+		match_by_ifindex(&match, entry->master_index);
 
 		if ((err = match_if(&match, match_master, entry)))
 			return err;
@@ -117,6 +118,7 @@ static int process(struct if_entry *entry, struct list *netns_list)
 		match_init(&match);
 		match.netns_list = netns_list;
 		match.exclude = entry;
+		match_by_ifindex(&match, entry->link_index);
 
 		if ((err = match_if(&match, match_link, entry)))
 			return err;
@@ -14,11 +14,186 @@
  */
 
 #include "match.h"
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include "hash.h"
 #include "if.h"
 #include "master.h"
 #include "netns.h"
 
+/* Interfaces sharing the same key, in the order of the netns list. */
+struct match_bucket {
+	struct hash_node n;
+	struct if_entry **entries;
+	int count, size;
+};
+
+/* Indexes of the interfaces of index_list, one per key type, each built
+ * on the first search using that key. */
+static struct list *index_list;
+static struct hash_table indexes[MK_MAX + 1];
+static int index_built[MK_MAX + 1];
+
+/* Returns 0 if the entry has no such key. */
+static int match_entry_key(int key, struct if_entry *entry, const void **data,
+			   size_t *len)
+{
+	switch (key) {
+	case MK_IFINDEX:
+		*data = &entry->if_index;
+		*len = sizeof(entry->if_index);
+		return entry->if_index != 0;
+	case MK_IFNAME:
+		if (!entry->if_name)
+			return 0;
+		*data = entry->if_name;
+		*len = strlen(entry->if_name);
+		return 1;
+	case MK_PCI_PATH:
+		if (!entry->pci_path)
+			return 0;
+		*data = entry->pci_path;
+		*len = strlen(entry->pci_path);
+		return 1;
+	}
+	return 0;
+}
+
+static int match_key_equal(int key, struct if_entry *entry, const void *data,
+			   size_t len)
+{
+	const void *edata;
+	size_t elen;
+
+	return match_entry_key(key, entry, &edata, &elen) &&
+	       elen == len && !memcmp(edata, data, len);
+}
+
+static struct match_bucket *match_bucket_find(int key, const void *data,
+					      size_t len)
+{
+	struct match_bucket *bucket;
+
+	hash_for_each_match(bucket, indexes[key], hash_mem(data, len))
+		if (match_key_equal(key, bucket->entries[0], data, len))
+			return bucket;
+	return NULL;
+}
+
+static int match_bucket_add(int key, struct if_entry *entry)
+{
+	struct match_bucket *bucket;
+	struct if_entry **entries;
+	const void *data;
+	size_t len;
+	int err;
+
+	if (!match_entry_key(key, entry, &data, &len))
+		return 0;
+	bucket = match_bucket_find(key, data, len);
+	if (!bucket) {
+		bucket = calloc(1, sizeof(*bucket));
+		if (!bucket)
+			return ENOMEM;
+		if ((err = hash_add(&indexes[key], &bucket->n, hash_mem(data, len)))) {
+			free(bucket);
+			return err;
+		}
+	}
+	if (bucket->count == bucket->size) {
+		entries = realloc(bucket->entries,
+				  (bucket->size ? bucket->size * 2 : 1) * sizeof(*entries));
+		if (!entries)
+			return ENOMEM;
+		bucket->entries = entries;
+		bucket->size = bucket->size ? bucket->size * 2 : 1;
+	}
+	bucket->entries[bucket->count++] = entry;
+	return 0;
+}
+
+static void match_bucket_destruct(struct match_bucket *bucket)
+{
+	free(bucket->entries);
+}
+
+static int match_index_build(int key, struct list *netns_list)
+{
+	struct netns_entry *ns;
+	struct if_entry *entry;
+	int err;
+
+	list_for_each(ns, *netns_list) {
+		list_for_each(entry, ns->ifaces) {
+			if ((err = match_bucket_add(key, entry))) {
+				hash_free(&indexes[key], (destruct_f)match_bucket_destruct);
+				return err;
+			}
+		}
+	}
+	index_built[key] = 1;
+	return 0;
+}
+
+int match_index_add(struct if_entry *entry)
+{
+	int key, err;
+
+	for (key = MK_NONE + 1; key <= MK_MAX; key++)
+		if (index_built[key] && (err = match_bucket_add(key, entry)))
+			return err;
+	return 0;
+}
+
+void match_index_free(void)
+{
+	int key;
+
+	for (key = MK_NONE + 1; key <= MK_MAX; key++) {
+		hash_free(&indexes[key], (destruct_f)match_bucket_destruct);
+		index_built[key] = 0;
+	}
+	index_list = NULL;
+}
+
+/* Returns 1 if the index for the key of desc can be used. A search in
+ * a single name space uses the index only if it exists already. */
+static int match_index_ready(struct match_desc *desc)
+{
+	if (!desc->netns_list)
+		return index_built[desc->key];
+	if (index_list != desc->netns_list) {
+		match_index_free();
+		index_list = desc->netns_list;
+	}
+	if (!index_built[desc->key] && match_index_build(desc->key, index_list))
+		return 0;
+	return 1;
+}
+
+/* Returns 1 if the search is finished, negative error or 0 otherwise. */
+static int match_try(struct match_desc *desc, struct if_entry *entry,
+		     match_callback_f callback, void *arg)
+{
+	int res;
+
+	if (entry == desc->exclude)
+		return 0;
+	res = callback(entry, arg);
+	if (res < 0)
+		return res;
+	if (res > desc->best) {
+		desc->found = entry;
+		desc->best = res;
+		desc->count = 1;
+		if (desc->mode == MM_FIRST)
+			return 1;
+	} else if (res == desc->best)
+		desc->count++;
+	return 0;
+}
+
 /* Matches only on desc->ns */
 static int match_if_ns(struct match_desc *desc, match_callback_f callback, void *arg)
 {
@@ -26,29 +201,45 @@ static int match_if_ns(struct match_desc *desc, match_callback_f callback, void
 	int res;
 
 	list_for_each(entry, desc->ns->ifaces) {
-		if (entry == desc->exclude)
+		if (desc->key &&
+		    !match_key_equal(desc->key, entry, desc->key_data, desc->key_len))
 			continue;
-		res = callback(entry, arg);
-		if (res < 0)
-			return -res;
-		if (res > desc->best) {
-			desc->found = entry;
-			desc->best = res;
-			desc->count = 1;
-			if (desc->mode == MM_FIRST)
-				return 0;
-		} else if (res == desc->best)
-			desc->count++;
+		res = match_try(desc, entry, callback, arg);
+		if (res)
+			return res < 0 ? -res : 0;
 	}
 
 	return 0;
 }
 
+/* Matches only on the interfaces having the key of desc */
+static int match_if_index(struct match_desc *desc, match_callback_f callback,
+			  void *arg)
+{
+	struct match_bucket *bucket;
+	int i, res;
+
+	bucket = match_bucket_find(desc->key, desc->key_data, desc->key_len);
+	if (!bucket)
+		return 0;
+	for (i = 0; i < bucket->count; i++) {
+		if (!desc->netns_list && bucket->entries[i]->ns != desc->ns)
+			continue;
+		res = match_try(desc, bucket->entries[i], callback, arg);
+		if (res)
+			return res < 0 ? -res : 0;
+	}
+	return 0;
+}
+
 int match_if(struct match_desc *desc, match_callback_f callback, void *arg)
 {
 	struct netns_entry *ns;
 	int err;
 
+	if (desc->key && match_index_ready(desc))
+		return match_if_index(desc, callback, arg);
+
 	if (desc->netns_list) {
 		list_for_each(ns, *desc->netns_list) {
 			desc->ns = ns;
@@ -66,17 +257,10 @@ struct if_entry *match_if_netnsid(unsigned int ifindex, int netnsid,
 				  struct netns_entry *current)
 {
 	struct netns_id *ptr;
-	struct if_entry *entry;
 
-	list_for_each(ptr, current->ids) {
-		if (ptr->id == netnsid) {
-			list_for_each(entry, ptr->ns->ifaces) {
-				if (entry->if_index == ifindex)
-					return entry;
-			}
-			break;
-		}
-	}
+	hash_for_each_match(ptr, current->ids, hash_u32(netnsid))
+		if (ptr->id == netnsid)
+			return if_find_index(ptr->ns, ifindex);
 	return NULL;
 }
 
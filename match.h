@@ -27,6 +27,13 @@ typedef int (*match_callback_f)(struct if_entry *, void *);
 #define MM_HEURISTIC	0
 #define MM_FIRST	1
 
+/* Keys for the match_by_* functions */
+#define MK_NONE		0
+#define MK_IFINDEX	1
+#define MK_IFNAME	2
+#define MK_PCI_PATH	3
+#define MK_MAX		MK_PCI_PATH
+
 struct match_desc {
 	/* Mode of searching, heuristic by default */
 	int mode; /* MM_* */
@@ -38,6 +45,14 @@ struct match_desc {
 	struct list *netns_list;
 	struct netns_entry *ns;
 
+	/* Consider only interfaces with the given key, see match_by_*.
+	 * Such interfaces are looked up in an index instead of walking all
+	 * of them. */
+	int key; /* MK_* */
+	unsigned int key_ifindex;
+	const void *key_data;
+	size_t key_len;
+
 	/* Internal. Use match_found and match_ambiguous functions. */
 	struct if_entry *found;
 	int best, count;
@@ -65,10 +80,37 @@ static inline void match_init(struct match_desc *desc)
 	memset(desc, 0, sizeof(struct match_desc));
 }
 
+static inline void match_by_ifindex(struct match_desc *desc, unsigned int ifindex)
+{
+	desc->key = MK_IFINDEX;
+	desc->key_ifindex = ifindex;
+	desc->key_data = &desc->key_ifindex;
+	desc->key_len = sizeof(ifindex);
+}
+
+static inline void match_by_name(struct match_desc *desc, const char *name)
+{
+	desc->key = MK_IFNAME;
+	desc->key_data = name;
+	desc->key_len = strlen(name);
+}
+
+static inline void match_by_pci_path(struct match_desc *desc, const char *path)
+{
+	desc->key = MK_PCI_PATH;
+	desc->key_data = path;
+	desc->key_len = strlen(path);
+}
+
 /* Find interface using netnsid. */
 struct if_entry *match_if_netnsid(unsigned int ifindex, int netnsid,
 				  struct netns_entry *current);
 
 void match_all_netnsid(struct list *netns_list);
 
+/* The indexes are built on the first keyed search in a netns list. The
+ * interfaces created after that have to be added by match_index_add. */
+int match_index_add(struct if_entry *entry);
+void match_index_free(void);
+
 #endif
@@ -20,19 +20,35 @@
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <poll.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include "capture.h"
 #include "list.h"
 #include "utils.h"
 
+#include "compat.h"
+
 #define NLMSG_BASIC_SIZE	16384
+/* the kernel never puts more than 32 kB into a single dump datagram;
+ * larger datagrams are reported as truncated */
+#define NL_RECV_SIZE		32768
 
 #define NL_TIMEOUT_MS		500
 #define NL_RETRY_COUNT		16
+#define NL_BATCH_EVENTS		64
+
+/* genetlink families resolved by genl_family_id */
+#define GENL_FAMILY_CACHE	8
+
+#define NL_REQ_QUEUED		0
+#define NL_REQ_SENT		1
+#define NL_REQ_DONE		2
 
 int nl_open(struct nl_handle *hnd, int family)
 {
@@ -41,10 +57,17 @@ int nl_open(struct nl_handle *hnd, int family)
 	struct sockaddr_nl sa;
 	socklen_t sa_len;
 
+	hnd->seq = 0;
+	hnd->strict = 0;
+	hnd->family = family;
+	hnd->netns = capture_get_netns();
+	hnd->replay = NULL;
+	if (capture_replaying())
+		return -capture_nl_open(hnd);
+
 	hnd->fd = socket(AF_NETLINK, SOCK_RAW, family);
 	if (hnd->fd < 0)
 		return -errno;
-	hnd->seq = 0;
 	bufsize = 32768;
 	if (setsockopt(hnd->fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize)) < 0)
 		goto err_out;
@@ -70,9 +93,48 @@ err_out:
 
 void nl_close(struct nl_handle *hnd)
 {
+	if (hnd->replay)
+		capture_nl_close(hnd);
 	close(hnd->fd);
 }
 
+/* sendmsg and recvmsg, recording or replaying the traffic if requested */
+static ssize_t nl_sendmsg(struct nl_handle *hnd, const struct msghdr *msg)
+{
+	ssize_t len;
+	int err;
+
+	if (hnd->replay) {
+		err = capture_nl_replay(hnd, msg);
+		if (err) {
+			errno = err;
+			return -1;
+		}
+		return 0;
+	}
+	len = sendmsg(hnd->fd, msg, 0);
+	if (len >= 0)
+		capture_nl_sent(hnd, msg);
+	return len;
+}
+
+static ssize_t nl_recvmsg(struct nl_handle *hnd, struct msghdr *msg, int flags)
+{
+	struct sockaddr_nl *sa = msg->msg_name;
+	ssize_t len;
+
+	len = recvmsg(hnd->fd, msg, flags);
+	if (len <= 0)
+		return len;
+	if (hnd->replay) {
+		sa->nl_pid = 0;
+		capture_nl_refill(hnd);
+	} else if (!sa->nl_pid) {
+		capture_nl_received(hnd, msg->msg_iov->iov_base, len);
+	}
+	return len;
+}
+
 static struct nlmsg *nlmsg_alloc(unsigned int size)
 {
 	struct nlmsg *msg;
@@ -200,32 +262,32 @@ static void nlmsg_reset_start(struct nlmsg *msg)
 	msg->start = NLMSG_ALIGN(sizeof(struct nlmsghdr));
 }
 
-struct nlattr **nlmsg_attrs(struct nlmsg *msg, int max)
+void nla_parse(struct nlattr **tb, int max, const void *buf, int len,
+	       const struct nla_policy *policy)
 {
-	struct nlattr **tb;
+	int type;
 
-	tb = calloc(max + 1, sizeof(struct nlattr *));
-	if (!tb)
-		return NULL;
-	for_each_nla(a, msg) {
-		if (a->nla_type <= max)
-			tb[a->nla_type] = a;
+	memset(tb, 0, (max + 1) * sizeof(*tb));
+	for_each_nla_buf(a, buf, len) {
+		type = a->nla_type & NLA_TYPE_MASK;
+		if (type > max)
+			continue;
+		if (policy && nla_len(a) < policy[type].min_len)
+			continue;
+		tb[type] = a;
 	}
-	return tb;
 }
 
-struct nlattr **nla_nested_attrs(struct nlattr *nla, int max)
+void nlmsg_parse(struct nlmsg *msg, struct nlattr **tb, int max,
+		 const struct nla_policy *policy)
 {
-	struct nlattr **tb;
+	nla_parse(tb, max, msg->buf + msg->start, msg->len - msg->start, policy);
+}
 
-	tb = calloc(max + 1, sizeof(struct nlattr *));
-	if (!tb)
-		return NULL;
-	for_each_nla_nested(a, nla) {
-		if (a->nla_type <= max)
-			tb[a->nla_type] = a;
-	}
-	return tb;
+void nla_parse_nested(struct nlattr **tb, int max, const struct nlattr *nla,
+		      const struct nla_policy *policy)
+{
+	nla_parse(tb, max, nla_read(nla), nla_len(nla), policy);
 }
 
 int nla_put(struct nlmsg *msg, int type, const void *data, int len)
@@ -253,11 +315,65 @@ static int nl_send(struct nl_handle *hnd, struct iovec *iov, int iovlen)
 	struct nlmsghdr *src = iov->iov_base;
 
 	src->nlmsg_seq = ++hnd->seq;
-	if (sendmsg(hnd->fd, &msg, 0) < 0)
+	if (nl_sendmsg(hnd, &msg) < 0)
 		return errno;
 	return 0;
 }
 
+static int nlmsg_copy(struct nlmsg **dest, struct nlmsghdr *n)
+{
+	int err;
+
+	*dest = nlmsg_alloc(n->nlmsg_len);
+	if (!*dest)
+		return ENOMEM;
+	err = nlmsg_put_raw(*dest, n, n->nlmsg_len, 0);
+	if (err) {
+		nlmsg_free(*dest);
+		*dest = NULL;
+		return err;
+	}
+	nlmsg_reset_start(*dest);
+	return 0;
+}
+
+/* Processes one datagram received from the kernel. Messages replying to the
+ * last request sent on hnd are appended to the *dest list.
+ * Returns 0 if more data is expected, -1 if the reply is complete, positive
+ * error code in case of an error. */
+static int nl_parse_reply(struct nl_handle *hnd, void *buf, int len, int is_dump,
+			  struct nlmsg **dest, struct nlmsg **tail)
+{
+	struct nlmsghdr *n;
+	struct nlmsg *entry;
+	int err;
+
+	for (n = buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+		if (n->nlmsg_pid != hnd->pid || n->nlmsg_seq != hnd->seq)
+			continue;
+		if (is_dump && n->nlmsg_type == NLMSG_DONE)
+			return -1;
+		if (n->nlmsg_type == NLMSG_ERROR) {
+			struct nlmsgerr *nlerr = (struct nlmsgerr *)NLMSG_DATA(n);
+
+			/* error 0 is an ack */
+			return nlerr->error ? -nlerr->error : -1;
+		}
+		err = nlmsg_copy(&entry, n);
+		if (err)
+			return err;
+		if (!*dest)
+			*dest = entry;
+		else
+			(*tail)->next = entry;
+		*tail = entry;
+
+		if (!is_dump)
+			return -1;
+	}
+	return 0;
+}
+
 static int nl_recv(struct nl_handle *hnd, struct nlmsg **dest, int is_dump)
 {
 	struct sockaddr_nl sa = {
@@ -270,11 +386,9 @@ static int nl_recv(struct nl_handle *hnd, struct nlmsg **dest, int is_dump)
 		.msg_iov = &iov,
 		.msg_iovlen = 1,
 	};
-	char buf[16384];
+	char buf[NL_RECV_SIZE];
 	int len, err;
-	struct nlmsghdr *n;
-	struct nlmsg *ptr = NULL; /* GCC false positive */
-	struct nlmsg *entry;
+	struct nlmsg *tail = NULL;
 	struct pollfd pfd;
 
 	*dest = NULL;
@@ -292,7 +406,7 @@ static int nl_recv(struct nl_handle *hnd, struct nlmsg **dest, int is_dump)
 			err = ETIME;
 			goto err_out;
 		}
-		len = recvmsg(hnd->fd, &msg, 0);
+		len = nl_recvmsg(hnd, &msg, 0);
 		if (len < 0) {
 			err = errno;
 			goto err_out;
@@ -301,40 +415,19 @@ static int nl_recv(struct nl_handle *hnd, struct nlmsg **dest, int is_dump)
 			err = EPIPE;
 			goto err_out;
 		}
+		if (msg.msg_flags & MSG_TRUNC) {
+			err = EMSGSIZE;
+			goto err_out;
+		}
 		if (sa.nl_pid) {
 			/* not from the kernel */
 			continue;
 		}
-		for (n = (struct nlmsghdr *)buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
-			if (n->nlmsg_pid != hnd->pid || n->nlmsg_seq != hnd->seq)
-				continue;
-			if (is_dump && n->nlmsg_type == NLMSG_DONE)
-				return 0;
-			if (n->nlmsg_type == NLMSG_ERROR) {
-				struct nlmsgerr *nlerr = (struct nlmsgerr *)NLMSG_DATA(n);
-
-				err = -nlerr->error;
-				goto err_out;
-			}
-			entry = nlmsg_alloc(n->nlmsg_len);
-			if (!entry) {
-				err = ENOMEM;
-				goto err_out;
-			}
-			if (!*dest)
-				*dest = entry;
-			else
-				ptr->next = entry;
-			ptr = entry;
-
-			err = nlmsg_put_raw(entry, n, n->nlmsg_len, 0);
-			if (err)
-				goto err_out;
-			nlmsg_reset_start(entry);
-
-			if (!is_dump)
-				return 0;
-		}
+		err = nl_parse_reply(hnd, buf, len, is_dump, dest, &tail);
+		if (err < 0)
+			return 0;
+		if (err)
+			goto err_out;
 	}
 err_out:
 	nlmsg_free(*dest);
@@ -384,9 +477,419 @@ int nl_exchange(struct nl_handle *hnd, struct nlmsg *src, struct nlmsg **dest)
 	}
 }
 
+/* Receives the reply to a dump, passing the messages to the callback
+ * directly from the receive buffer. If the dump is found to be
+ * interrupted, EINTR is returned after all of it was passed to the
+ * callback. An error returned by the callback is reported only after the
+ * dump is drained, so that the socket can be reused. */
+static int nl_dump_recv(struct nl_handle *hnd, nl_dump_cb_t cb, void *arg)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name = &sa,
+		.msg_namelen = sizeof(sa),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char buf[NL_RECV_SIZE];
+	struct nlmsg view = { .next = NULL };
+	struct nlmsghdr *n;
+	struct pollfd pfd;
+	int len, err, intr = 0, cb_err = 0;
+
+	pfd.fd = hnd->fd;
+	pfd.events = POLLIN;
+	while (1) {
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		err = poll(&pfd, 1, NL_TIMEOUT_MS);
+		if (err < 0)
+			return errno;
+		if (err == 0 || !(pfd.revents & POLLIN))
+			return ETIME;
+		len = nl_recvmsg(hnd, &msg, 0);
+		if (len < 0)
+			return errno;
+		if (!len)
+			return EPIPE;
+		if (msg.msg_flags & MSG_TRUNC)
+			return EMSGSIZE;
+		if (sa.nl_pid) {
+			/* not from the kernel */
+			continue;
+		}
+		for (n = (struct nlmsghdr *)buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			if (n->nlmsg_pid != hnd->pid || n->nlmsg_seq != hnd->seq)
+				continue;
+			if (n->nlmsg_type == NLMSG_DONE) {
+				if (cb_err)
+					return cb_err;
+				return intr ? EINTR : 0;
+			}
+			if (n->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *nlerr = (struct nlmsgerr *)NLMSG_DATA(n);
+
+				return -nlerr->error;
+			}
+			if (n->nlmsg_flags & NLM_F_DUMP_INTR)
+				intr = 1;
+			if (cb_err)
+				continue;
+			view.buf = n;
+			view.len = n->nlmsg_len;
+			nlmsg_reset_start(&view);
+			cb_err = cb(&view, arg);
+		}
+	}
+}
+
+int nl_dump(struct nl_handle *hnd, struct nlmsg *src, nl_dump_cb_t cb,
+	    nl_restart_cb_t restart, void *arg)
+{
+	struct iovec iov = {
+		.iov_base = src->buf,
+		.iov_len = src->len,
+	};
+	int retry = NL_RETRY_COUNT;
+	int err;
+
+	while (1) {
+		if (!retry--)
+			return ETIME;
+
+		err = nl_send(hnd, &iov, 1);
+		if (err)
+			return err;
+		err = nl_dump_recv(hnd, cb, arg);
+		if (err == ETIME || err == EAGAIN) {
+			restart(arg);
+			continue;
+		}
+		return err;
+	}
+}
+
+int nl_dump_list(struct nlmsg *msg, nl_dump_cb_t cb, void *arg)
+{
+	int err, intr = 0;
+
+	for (; msg; msg = msg->next) {
+		if (nlmsg_get_hdr(msg)->nlmsg_flags & NLM_F_DUMP_INTR)
+			intr = 1;
+		if ((err = cb(msg, arg)))
+			return err;
+	}
+	return intr ? EINTR : 0;
+}
+
+int nl_exchange_many(struct nl_handle *hnd, struct nlmsg **src,
+		     struct nlmsg **dest, int count)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name = &sa,
+		.msg_namelen = sizeof(sa),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char buf[NL_RECV_SIZE];
+	struct nlmsghdr *n;
+	struct pollfd pfd;
+	struct iovec *out;
+	unsigned int first, idx;
+	int i, len, err, pending;
+	char *done;
+
+	out = calloc(count, sizeof(*out));
+	done = calloc(count, sizeof(*done));
+	if (!out || !done) {
+		err = ENOMEM;
+		goto out_free;
+	}
+	first = hnd->seq + 1;
+	for (i = 0; i < count; i++) {
+		nlmsg_get_hdr(src[i])->nlmsg_seq = ++hnd->seq;
+		out[i].iov_base = src[i]->buf;
+		out[i].iov_len = src[i]->len;
+		dest[i] = NULL;
+	}
+	/* All requests go in a single datagram, the kernel processes them
+	 * one by one. */
+	msg.msg_iov = out;
+	msg.msg_iovlen = count;
+	if (nl_sendmsg(hnd, &msg) < 0) {
+		err = errno;
+		goto out_free;
+	}
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	pfd.fd = hnd->fd;
+	pfd.events = POLLIN;
+	pending = count;
+	while (pending) {
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		err = poll(&pfd, 1, NL_TIMEOUT_MS);
+		if (err < 0) {
+			err = errno;
+			goto err_out;
+		}
+		if (err == 0 || !(pfd.revents & POLLIN)) {
+			err = ETIME;
+			goto err_out;
+		}
+		len = nl_recvmsg(hnd, &msg, 0);
+		if (len < 0) {
+			err = errno;
+			goto err_out;
+		}
+		if (!len) {
+			err = EPIPE;
+			goto err_out;
+		}
+		if (msg.msg_flags & MSG_TRUNC) {
+			err = EMSGSIZE;
+			goto err_out;
+		}
+		if (sa.nl_pid)
+			continue;
+		for (n = (void *)buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			idx = n->nlmsg_seq - first;
+			if (n->nlmsg_pid != hnd->pid || idx >= (unsigned int)count ||
+			    done[idx])
+				continue;
+			done[idx] = 1;
+			pending--;
+			if (n->nlmsg_type == NLMSG_ERROR)
+				continue;
+			if ((err = nlmsg_copy(&dest[idx], n)))
+				goto err_out;
+		}
+	}
+	err = 0;
+	goto out_free;
+
+err_out:
+	for (i = 0; i < count; i++) {
+		nlmsg_free(dest[i]);
+		dest[i] = NULL;
+	}
+out_free:
+	free(done);
+	free(out);
+	return err;
+}
+
+int nl_batch_init(struct nl_batch *batch)
+{
+	batch->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (batch->epfd < 0)
+		return errno;
+	list_init(&batch->requests);
+	return 0;
+}
+
+void nl_batch_free(struct nl_batch *batch)
+{
+	close(batch->epfd);
+}
+
+void nl_batch_add(struct nl_batch *batch, struct nl_request *req)
+{
+	req->dest = req->tail = NULL;
+	req->err = 0;
+	req->state = NL_REQ_QUEUED;
+	req->retry = NL_RETRY_COUNT;
+	list_append(&batch->requests, node(req));
+}
+
+static int nl_request_is_dump(struct nl_request *req)
+{
+	return !!(nlmsg_get_hdr(req->src)->nlmsg_flags & NLM_F_DUMP);
+}
+
+/* (Re)sends the request, dropping any partial reply. */
+static int nl_request_send(struct nl_request *req)
+{
+	struct iovec iov = {
+		.iov_base = req->src->buf,
+		.iov_len = req->src->len,
+	};
+
+	nlmsg_free(req->dest);
+	req->dest = req->tail = NULL;
+	if (!req->retry--)
+		return EINTR;
+	return nl_send(req->hnd, &iov, 1);
+}
+
+/* Starts the first queued request for the handle, beginning at req.
+ * Returns 1 if a request was sent, 0 if there's none left for the handle. */
+static int nl_batch_start(struct nl_batch *batch, struct nl_request *req, int op)
+{
+	struct nl_handle *hnd = req->hnd;
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	for (; node_valid(req); req = node_next(req)) {
+		if (req->hnd != hnd || req->state != NL_REQ_QUEUED)
+			continue;
+		req->state = NL_REQ_DONE;
+		if ((req->err = nl_request_send(req)))
+			continue;
+		ev.data.ptr = req;
+		if (epoll_ctl(batch->epfd, op, hnd->fd, &ev) < 0) {
+			req->err = errno;
+			continue;
+		}
+		req->state = NL_REQ_SENT;
+		return 1;
+	}
+	if (op == EPOLL_CTL_MOD)
+		epoll_ctl(batch->epfd, EPOLL_CTL_DEL, hnd->fd, NULL);
+	return 0;
+}
+
+/* Reads everything available for the request.
+ * Returns 0 if more data is expected, -1 if the request is finished, with
+ * req->err set accordingly. */
+static int nl_batch_read(struct nl_request *req)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name = &sa,
+		.msg_namelen = sizeof(sa),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char buf[NL_RECV_SIZE];
+	int is_dump = nl_request_is_dump(req);
+	int len, err;
+
+	while (1) {
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		len = nl_recvmsg(req->hnd, &msg, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			err = errno;
+			goto err_out;
+		}
+		if (!len) {
+			err = EPIPE;
+			goto err_out;
+		}
+		if (msg.msg_flags & MSG_TRUNC) {
+			err = EMSGSIZE;
+			goto err_out;
+		}
+		if (sa.nl_pid) {
+			/* not from the kernel */
+			continue;
+		}
+		err = nl_parse_reply(req->hnd, buf, len, is_dump, &req->dest, &req->tail);
+		if (!err)
+			continue;
+		if (err == EAGAIN || err == EINTR) {
+			if ((err = nl_request_send(req)))
+				goto err_out;
+			continue;
+		}
+		if (err > 0)
+			goto err_out;
+		return -1;
+	}
+err_out:
+	nlmsg_free(req->dest);
+	req->dest = NULL;
+	req->err = err;
+	return -1;
+}
+
+int nl_batch_run(struct nl_batch *batch)
+{
+	struct epoll_event events[NL_BATCH_EVENTS];
+	struct nl_request *req, *ptr;
+	int pending = 0;
+	int i, n;
+
+	/* Start the first request of every handle. */
+	list_for_each(req, batch->requests) {
+		if (req->state != NL_REQ_QUEUED)
+			continue;
+		list_for_each(ptr, batch->requests)
+			if (ptr->hnd == req->hnd && ptr->state == NL_REQ_SENT)
+				break;
+		if (!node_valid(ptr))
+			pending += nl_batch_start(batch, req, EPOLL_CTL_ADD);
+	}
+
+	while (pending) {
+		n = epoll_wait(batch->epfd, events, NL_BATCH_EVENTS, NL_TIMEOUT_MS);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (!n) {
+			/* Timed out, resend everything in flight. */
+			list_for_each(req, batch->requests) {
+				if (req->state != NL_REQ_SENT)
+					continue;
+				if (!(req->err = nl_request_send(req)))
+					continue;
+				req->state = NL_REQ_DONE;
+				pending--;
+				pending += nl_batch_start(batch, req, EPOLL_CTL_MOD);
+			}
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			req = events[i].data.ptr;
+			if (!nl_batch_read(req))
+				continue;
+			req->state = NL_REQ_DONE;
+			pending--;
+			pending += nl_batch_start(batch, req, EPOLL_CTL_MOD);
+		}
+	}
+	return 0;
+}
+
 int rtnl_open(struct nl_handle *hnd)
 {
-	return nl_open(hnd, NETLINK_ROUTE);
+	int err, len, one = 1;
+	void *val;
+
+	if ((err = nl_open(hnd, NETLINK_ROUTE)))
+		return err;
+	if (hnd->replay) {
+		/* the requests have to be the same as when recording */
+		if (!capture_get(CAPTURE_NL_STRICT, "strict", &val, &len)) {
+			hnd->strict = len == sizeof(int) && *(int *)val;
+			free(val);
+		}
+		return 0;
+	}
+	/* With strict checking, the kernel filters dumps according to the
+	 * request. Older kernels don't support it; the filters are applied
+	 * to the received messages anyway. */
+	hnd->strict = !setsockopt(hnd->fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK,
+				  &one, sizeof(one));
+	capture_put(CAPTURE_NL_STRICT, "strict", &hnd->strict, sizeof(int), 0);
+	return 0;
 }
 
 struct nlmsg *rtnlmsg_new(int type, int family, int flags, int size)
@@ -404,19 +907,207 @@ struct nlmsg *rtnlmsg_new(int type, int family, int flags, int size)
 	return res;
 }
 
-int rtnl_ifi_dump(struct nl_handle *hnd, int type, int family, struct nlmsg **dest)
+static int rtnl_put_filter(struct nlmsg *req, int type, const struct rtnl_filter *filter)
+{
+	switch (type) {
+	case RTM_GETLINK:
+		if (filter->ext_mask && nla_put_u32(req, IFLA_EXT_MASK, filter->ext_mask))
+			return ENOMEM;
+		break;
+	case RTM_GETROUTE:
+		if (filter->table && nla_put_u32(req, RTA_TABLE, filter->table))
+			return ENOMEM;
+		if (filter->ifindex && nla_put_u32(req, RTA_OIF, filter->ifindex))
+			return ENOMEM;
+		break;
+	}
+	return 0;
+}
+
+struct nlmsg *rtnl_dump_req(int type, int family, const struct rtnl_filter *filter)
+{
+	static const struct rtnl_filter no_filter;
+	struct nlmsg *req;
+
+	if (!filter)
+		filter = &no_filter;
+	req = nlmsg_new(type, NLM_F_DUMP);
+	if (!req)
+		return NULL;
+
+	/* Strict checking requires the correct header, with all fields
+	 * that cannot be used for filtering zeroed. */
+	switch (type) {
+	case RTM_GETLINK: {
+		struct ifinfomsg ifi = { .ifi_family = family };
+
+		if (nlmsg_put(req, &ifi, sizeof(ifi)))
+			goto err_out;
+		break;
+	}
+	case RTM_GETADDR: {
+		struct ifaddrmsg ifa = {
+			.ifa_family = family,
+			.ifa_index = filter->ifindex,
+		};
+
+		if (nlmsg_put(req, &ifa, sizeof(ifa)))
+			goto err_out;
+		break;
+	}
+	case RTM_GETROUTE: {
+		struct rtmsg rtm = {
+			.rtm_family = family,
+			.rtm_table = filter->table < 256 ? filter->table : RT_TABLE_UNSPEC,
+		};
+
+		if (nlmsg_put(req, &rtm, sizeof(rtm)))
+			goto err_out;
+		break;
+	}
+	default: {
+		struct rtgenmsg g = { .rtgen_family = family };
+
+		if (nlmsg_put_padded(req, &g, sizeof(g), sizeof(struct ifinfomsg)))
+			goto err_out;
+		break;
+	}
+	}
+	if (rtnl_put_filter(req, type, filter))
+		goto err_out;
+	return req;
+
+err_out:
+	nlmsg_free(req);
+	return NULL;
+}
+
+struct nlmsg *rtnl_link_req(int ifindex, unsigned int ext_mask)
+{
+	struct ifinfomsg ifi = { .ifi_index = ifindex };
+	struct nlmsg *req;
+
+	req = nlmsg_new(RTM_GETLINK, 0);
+	if (!req)
+		return NULL;
+	if (nlmsg_put(req, &ifi, sizeof(ifi)) ||
+	    (ext_mask && nla_put_u32(req, IFLA_EXT_MASK, ext_mask))) {
+		nlmsg_free(req);
+		return NULL;
+	}
+	return req;
+}
+
+static int rtnl_filter_match(const struct rtnl_filter *filter, struct nlmsghdr *n)
 {
+	int hdrlen, len, oif = 0;
+	void *data = NLMSG_DATA(n);
+	unsigned int table = 0;
+
+	switch (n->nlmsg_type) {
+	case RTM_NEWADDR:
+		hdrlen = sizeof(struct ifaddrmsg);
+		break;
+	case RTM_NEWROUTE:
+		hdrlen = sizeof(struct rtmsg);
+		break;
+	default:
+		return 1;
+	}
+	len = n->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(hdrlen));
+	if (len < 0)
+		/* leave malformed messages to the consumer */
+		return 1;
+
+	if (n->nlmsg_type == RTM_NEWROUTE) {
+		table = ((struct rtmsg *)data)->rtm_table;
+		for_each_nla_buf(a, data + NLMSG_ALIGN(hdrlen), len) {
+			if (a->nla_type == RTA_TABLE)
+				table = nla_read_u32(a);
+			else if (a->nla_type == RTA_OIF)
+				oif = nla_read_u32(a);
+		}
+	}
+
+	switch (n->nlmsg_type) {
+	case RTM_NEWADDR:
+		if (filter->ifindex &&
+		    filter->ifindex != (int)((struct ifaddrmsg *)data)->ifa_index)
+			return 0;
+		break;
+	case RTM_NEWROUTE:
+		if (filter->table && filter->table != table)
+			return 0;
+		if (filter->ifindex && filter->ifindex != oif)
+			return 0;
+		break;
+	}
+	return 1;
+}
+
+struct rtnl_filter_ctx {
+	const struct rtnl_filter *filter;
+	nl_dump_cb_t cb;
+	nl_restart_cb_t restart;
+	void *arg;
+};
+
+static int rtnl_filter_cb(struct nlmsg *msg, void *arg)
+{
+	struct rtnl_filter_ctx *ctx = arg;
+
+	if (!rtnl_filter_match(ctx->filter, nlmsg_get_hdr(msg)))
+		return 0;
+	return ctx->cb(msg, ctx->arg);
+}
+
+static void rtnl_filter_restart(void *arg)
+{
+	struct rtnl_filter_ctx *ctx = arg;
+
+	ctx->restart(ctx->arg);
+}
+
+int rtnl_dump(struct nl_handle *hnd, int type, int family,
+	      const struct rtnl_filter *filter,
+	      nl_dump_cb_t cb, nl_restart_cb_t restart, void *arg)
+{
+	struct rtnl_filter_ctx ctx = {
+		.filter = filter,
+		.cb = cb,
+		.restart = restart,
+		.arg = arg,
+	};
 	struct nlmsg *req;
 	int err;
 
-	req = rtnlmsg_new(type, family, NLM_F_DUMP, sizeof(struct ifinfomsg));
+	req = rtnl_dump_req(type, family, filter);
 	if (!req)
 		return ENOMEM;
-	err = nl_exchange(hnd, req, dest);
+	if (filter)
+		err = nl_dump(hnd, req, rtnl_filter_cb, rtnl_filter_restart, &ctx);
+	else
+		err = nl_dump(hnd, req, cb, restart, arg);
 	nlmsg_free(req);
 	return err;
 }
 
+int rtnl_dump_list(struct nlmsg *msg, const struct rtnl_filter *filter,
+		   nl_dump_cb_t cb, void *arg)
+{
+	int err, intr = 0;
+
+	for (; msg; msg = msg->next) {
+		if (nlmsg_get_hdr(msg)->nlmsg_flags & NLM_F_DUMP_INTR)
+			intr = 1;
+		if (filter && !rtnl_filter_match(filter, nlmsg_get_hdr(msg)))
+			continue;
+		if ((err = cb(msg, arg)))
+			return err;
+	}
+	return intr ? EINTR : 0;
+}
+
 int genl_open(struct nl_handle *hnd)
 {
 	return nl_open(hnd, NETLINK_GENERIC);
@@ -437,11 +1128,58 @@ struct nlmsg *genlmsg_new(int type, int cmd, int flags)
 	return res;
 }
 
+/* Family ids are global, not per name space, thus a successful lookup is
+ * valid for the whole run. */
+static struct {
+	char name[GENL_NAMSIZ];
+	unsigned int id;
+} genl_families[GENL_FAMILY_CACHE];
+static int genl_families_count;
+static pthread_mutex_t genl_families_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int genl_family_cached(const char *name)
+{
+	unsigned int res = 0;
+	int i;
+
+	pthread_mutex_lock(&genl_families_lock);
+	for (i = 0; i < genl_families_count; i++) {
+		if (!strcmp(genl_families[i].name, name)) {
+			res = genl_families[i].id;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&genl_families_lock);
+	return res;
+}
+
+static void genl_family_cache(const char *name, unsigned int id)
+{
+	int i;
+
+	if (strlen(name) >= GENL_NAMSIZ)
+		return;
+	pthread_mutex_lock(&genl_families_lock);
+	for (i = 0; i < genl_families_count; i++)
+		if (!strcmp(genl_families[i].name, name))
+			goto out;
+	if (genl_families_count < GENL_FAMILY_CACHE) {
+		strcpy(genl_families[genl_families_count].name, name);
+		genl_families[genl_families_count].id = id;
+		genl_families_count++;
+	}
+out:
+	pthread_mutex_unlock(&genl_families_lock);
+}
+
 unsigned int genl_family_id(struct nl_handle *hnd, const char *name)
 {
 	struct nlmsg *req, *resp;
-	int res = 0;
+	int res;
 
+	res = genl_family_cached(name);
+	if (res)
+		return res;
 	req = genlmsg_new(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0);
 	if (!req)
 		return 0;
@@ -458,6 +1196,9 @@ unsigned int genl_family_id(struct nl_handle *hnd, const char *name)
 		}
 	}
 
+	if (res)
+		genl_family_cache(name, res);
+
 out_resp:
 	nlmsg_free(resp);
 out_req:
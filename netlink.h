@@ -21,11 +21,20 @@
 #include <sys/socket.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
+#include "list.h"
+
+struct capture_queue;
 
 struct nl_handle {
 	int fd;
 	unsigned int pid;
 	unsigned int seq;
+	/* the kernel supports strict checking (and filtering of dumps) */
+	int strict;
+	int family;
+	/* the name space the socket was opened in, for capture.c */
+	unsigned int netns;
+	struct capture_queue *replay;
 };
 
 struct nlmsg {
@@ -43,14 +52,78 @@ struct nlmsg {
 int nl_open(struct nl_handle *hnd, int family);
 void nl_close(struct nl_handle *hnd);
 int nl_exchange(struct nl_handle *hnd, struct nlmsg *src, struct nlmsg **dest);
+/* Streaming dumps. The callback is called for every message of the dump;
+ * the message is valid only until the callback returns and must not be
+ * modified. Non-zero return value from the callback aborts the dump. If
+ * the dump needs to be restarted (it timed out), the restart callback is
+ * called first and the consumer is expected to drop everything received
+ * so far. A dump interrupted by a change in the kernel is not restarted:
+ * all of it is passed to the callback and EINTR is returned, the consumer
+ * decides whether and how to reconcile the possibly inconsistent data.
+ * Note that the kernel only flags that something changed during the dump,
+ * not what: the consumer cannot tell the changed objects apart and can
+ * only re-get everything it received. Objects created during the dump
+ * may be missing from it and are not found that way. */
+typedef int (*nl_dump_cb_t)(struct nlmsg *msg, void *arg);
+typedef void (*nl_restart_cb_t)(void *arg);
+
+int nl_dump(struct nl_handle *hnd, struct nlmsg *src, nl_dump_cb_t cb,
+	    nl_restart_cb_t restart, void *arg);
+/* Passes already received messages (e.g. from nl_batch) to a dump
+ * callback. Returns EINTR if the dump was interrupted, as nl_dump. */
+int nl_dump_list(struct nlmsg *msg, nl_dump_cb_t cb, void *arg);
+/* Sends count non-dump requests at once. dest[i] is set to the reply to
+ * src[i], or to NULL if the kernel responded with an error. */
+int nl_exchange_many(struct nl_handle *hnd, struct nlmsg **src,
+		     struct nlmsg **dest, int count);
+
+/* Asynchronous requests. All requests added to a batch are processed by
+ * nl_batch_run at once. Requests on different handles are in flight at the
+ * same time, requests on the same handle are sent one after another, in the
+ * order they were added. The caller owns the nl_request structures; after
+ * nl_batch_run, dest and err contain the result of each request. */
+struct nl_request {
+	struct node n;
+	struct nl_handle *hnd;
+	struct nlmsg *src;
+	struct nlmsg *dest;
+	int err;
+	/* private: */
+	struct nlmsg *tail;
+	int state;
+	int retry;
+};
+
+struct nl_batch {
+	int epfd;
+	struct list requests;
+};
+
+int nl_batch_init(struct nl_batch *batch);
+void nl_batch_free(struct nl_batch *batch);
+void nl_batch_add(struct nl_batch *batch, struct nl_request *req);
+int nl_batch_run(struct nl_batch *batch);
 
 struct nlmsg *nlmsg_new(int type, int flags);
 void nlmsg_free(struct nlmsg *msg);
 int nlmsg_put(struct nlmsg *msg, const void *data, int len);
 void *nlmsg_get(struct nlmsg *msg, int len);
 void nlmsg_unget(struct nlmsg *msg, int len);
-struct nlattr **nlmsg_attrs(struct nlmsg *msg, int max);
-struct nlattr **nla_nested_attrs(struct nlattr *nla, int max);
+
+/* Attribute parsing. The attributes are stored to the caller provided
+ * table tb of max + 1 entries, indexed by the attribute type; missing
+ * attributes are NULL. The policy, if given, is a table of max + 1
+ * entries; attributes shorter than their min_len are treated as missing. */
+struct nla_policy {
+	unsigned short min_len;
+};
+
+void nla_parse(struct nlattr **tb, int max, const void *buf, int len,
+	       const struct nla_policy *policy);
+void nlmsg_parse(struct nlmsg *msg, struct nlattr **tb, int max,
+		 const struct nla_policy *policy);
+void nla_parse_nested(struct nlattr **tb, int max, const struct nlattr *nla,
+		      const struct nla_policy *policy);
 
 #define for_each_nlmsg(iter, msg)				\
 	for (struct nlmsg *iter = (msg); iter; iter = iter->next)
@@ -92,29 +165,48 @@ static inline const void *nla_read(const struct nlattr *nla)
 	return nla + 1;
 }
 
+/* The integer readers return 0 for a too short attribute, nla_read_str
+ * returns an empty string for an attribute that is not nul terminated. */
 static inline uint8_t nla_read_u8(const struct nlattr *nla)
 {
-	return *(uint8_t *)(nla + 1);
+	uint8_t val = 0;
+
+	if (nla_len(nla) >= sizeof(val))
+		memcpy(&val, nla + 1, sizeof(val));
+	return val;
 }
 
 static inline uint16_t nla_read_u16(const struct nlattr *nla)
 {
-	return *(uint16_t *)(nla + 1);
+	uint16_t val = 0;
+
+	if (nla_len(nla) >= sizeof(val))
+		memcpy(&val, nla + 1, sizeof(val));
+	return val;
 }
 
 static inline uint32_t nla_read_u32(const struct nlattr *nla)
 {
-	return *(uint32_t *)(nla + 1);
+	uint32_t val = 0;
+
+	if (nla_len(nla) >= sizeof(val))
+		memcpy(&val, nla + 1, sizeof(val));
+	return val;
 }
 
 static inline int32_t nla_read_s32(const struct nlattr *nla)
 {
-	return *(int32_t *)(nla + 1);
+	return nla_read_u32(nla);
 }
 
 static inline const char *nla_read_str(const struct nlattr *nla)
 {
-	return (const char *)(nla + 1);
+	const char *str = (const char *)(nla + 1);
+	unsigned int len = nla_len(nla);
+
+	if (!len || str[len - 1])
+		return "";
+	return str;
 }
 
 #define __nla_buf_remaining(iter, buf, len)				\
@@ -138,7 +230,30 @@ static inline const char *nla_read_str(const struct nlattr *nla)
 
 int rtnl_open(struct nl_handle *hnd);
 struct nlmsg *rtnlmsg_new(int type, int family, int flags, int size);
-int rtnl_ifi_dump(struct nl_handle *hnd, int type, int family, struct nlmsg **dest);
+
+/* Dump filters; zero (NULL) fields match anything. Which fields apply
+ * depends on the dump:
+ *   RTM_GETADDR:  ifindex
+ *   RTM_GETROUTE: table, ifindex (output interface)
+ * The kernel filters the dump when it supports strict checking. The filter
+ * is applied to the received messages in any case.
+ *
+ * ext_mask is not a filter but the IFLA_EXT_MASK value of link dumps. */
+struct rtnl_filter {
+	int ifindex;
+	unsigned int table;
+	unsigned int ext_mask;
+};
+
+struct nlmsg *rtnl_dump_req(int type, int family, const struct rtnl_filter *filter);
+/* Request to get a single link, to be used with nl_exchange_many. */
+struct nlmsg *rtnl_link_req(int ifindex, unsigned int ext_mask);
+int rtnl_dump(struct nl_handle *hnd, int type, int family,
+	      const struct rtnl_filter *filter,
+	      nl_dump_cb_t cb, nl_restart_cb_t restart, void *arg);
+/* Like nl_dump_list, applying the filter. */
+int rtnl_dump_list(struct nlmsg *msg, const struct rtnl_filter *filter,
+		   nl_dump_cb_t cb, void *arg);
 
 /* genetlink */
 
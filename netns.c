@@ -17,62 +17,122 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syscall.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include "arena.h"
+#include "args.h"
+#include "capture.h"
 #include "handler.h"
+#include "hash.h"
 #include "if.h"
+#include "intern.h"
+#include "label.h"
 #include "list.h"
 #include "master.h"
 #include "match.h"
 #include "netlink.h"
 #include "sysfs.h"
+#include "tunnel.h"
+#include "utils.h"
+#include "handlers/route.h"
 
 #include "compat.h"
 
 #define NETNS_RUN_DIR "/var/run/netns"
 
-static long netns_get_kernel_id(const char *path)
+#define NETNS_PREFETCH_WINDOW	64
+#define NETNS_NSID_BATCH	64
+#define NETNS_PROC_BUF		(256 * 1024)
+/* minimum number of PIDs worth a separate thread */
+#define NETNS_PROC_CHUNK	1024
+
+struct netns_arg {
+	struct node n;
+	char *arg;
+};
+
+struct netns_pid {
+	struct node n;
+	pid_t pid;
+};
+
+static int jobs = 1;
+static int async_dumps;
+static int root_only;
+static int no_proc;
+static DECLARE_LIST(ns_include);
+static DECLARE_LIST(ns_exclude);
+static DECLARE_LIST(ns_dirs);
+static DECLARE_LIST(ns_pids);
+/* device of the nsfs file system */
+static dev_t nsfs_dev;
+
+struct netns_scan {
+	pthread_mutex_t lock;
+	struct netns_entry *next;
+	int window;
+	int err;
+};
+
+/* Identifies the name space by the nsfs inode behind an open fd. Returns
+ * -EINVAL if the fd does not refer to a name space. */
+static long netns_get_fd_kernel_id(int fd)
 {
-	char dest[PATH_MAX], *s, *endptr;
-	ssize_t len;
-	long result;
+	struct stat st;
 
-	len = readlink(path, dest, sizeof(dest));
-	if (len < 0)
+	if (fstat(fd, &st) < 0)
 		return -errno;
-	dest[len] = 0;
-	if (strncmp("net:[", dest, 5))
-		return -EINVAL;
-	s = strrchr(dest, ']');
-	if (!s)
-		return -EINVAL;
-	*s = '\0';
-	s = dest + 5;
-	result = strtol(s, &endptr, 10);
-	if (!*s || *endptr)
+	if (st.st_dev != nsfs_dev)
 		return -EINVAL;
-	return result;
+	return st.st_ino;
 }
 
-static struct netns_entry *netns_check_duplicate(struct list *netns_list,
+/* Index of the already known name spaces, keyed by kernel_id. Used for
+ * deduplication during enumeration only. */
+struct netns_index {
+	struct hash_node n;
+	struct netns_entry *ns;
+};
+
+static struct netns_entry *netns_check_duplicate(struct hash_table *index,
 						 long int kernel_id)
 {
-	struct netns_entry *ns;
+	struct netns_index *ptr;
 
-	list_for_each(ns, *netns_list)
-		if (ns->kernel_id == kernel_id)
-			return ns;
+	hash_for_each_match(ptr, *index, hash_u64(kernel_id))
+		if (ptr->ns->kernel_id == kernel_id)
+			return ptr->ns;
 	return NULL;
 }
 
+static int netns_index_add(struct hash_table *index, struct netns_entry *ns)
+{
+	struct netns_index *ptr;
+	int err;
+
+	ptr = malloc(sizeof(*ptr));
+	if (!ptr)
+		return ENOMEM;
+	ptr->ns = ns;
+	if ((err = hash_add(index, &ptr->n, hash_u64(ns->kernel_id)))) {
+		free(ptr);
+		return err;
+	}
+	return 0;
+}
+
 static struct netns_entry *netns_create()
 {
 	struct netns_entry *ns;
@@ -83,54 +143,51 @@ static struct netns_entry *netns_create()
 
 	list_init(&ns->ifaces);
 	list_init(&ns->warnings);
+	ns->ioctl_fd = -1;
 	return ns;
 }
 
 static int netns_get_var_entry(struct netns_entry **result,
-			       struct list *netns_list,
-			       const char *name)
+			       struct hash_table *index,
+			       const char *dir, const char *name)
 {
 	struct netns_entry *entry;
 	char path[PATH_MAX];
 	long kernel_id;
-	int err;
 
 	*result = entry = netns_create();
 	if (!entry)
 		return ENOMEM;
 
-	snprintf(path, sizeof(path), "%s/%s", NETNS_RUN_DIR, name);
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
 	entry->fd = open(path, O_RDONLY);
 	if (entry->fd < 0)
 		return errno;
-	/* to get the kernel_id, we need to switch to that ns and examine
-	 * /proc/self */
-	err = netns_switch(entry);
-	if (err)
-		return err;
-	kernel_id = netns_get_kernel_id("/proc/self/ns/net");
-	if (kernel_id < 0)
-		return -kernel_id;
-	if (netns_check_duplicate(netns_list, kernel_id)) {
+	kernel_id = netns_get_fd_kernel_id(entry->fd);
+	if (kernel_id == -EINVAL || netns_check_duplicate(index, kernel_id)) {
+		/* not a name space (e.g. a stale entry) or a duplicate */
 		close(entry->fd);
 		free(entry);
 		return -1;
 	}
+	if (kernel_id < 0)
+		return -kernel_id;
 	entry->kernel_id = kernel_id;
-	entry->name = strdup(name);
+	/* Entries of other directories than the standard one are named
+	 * by their full path to keep the names unique. */
+	entry->name = intern(strcmp(dir, NETNS_RUN_DIR) ? path : name);
 	if (!entry->name)
 		return ENOMEM;
-	return netns_switch_root();
+	return 0;
 }
 
-static void netns_proc_entry_set_name(struct netns_entry *entry,
-				      const char *spid)
+static void netns_proc_entry_set_name(struct netns_entry *entry)
 {
 	char path[PATH_MAX], buf[PATH_MAX];
 	ssize_t len;
 	int commfd;
 
-	snprintf(path, sizeof(path), "/proc/%s/comm", spid);
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int)entry->pid);
 	commfd = open(path, O_RDONLY);
 	len = -1;
 	if (commfd >= 0) {
@@ -143,84 +200,48 @@ static void netns_proc_entry_set_name(struct netns_entry *entry,
 		close(commfd);
 	}
 	if (len >= 0)
-		snprintf(buf, sizeof(buf), "PID %s (%s)", spid, path);
+		snprintf(buf, sizeof(buf), "PID %d (%s)", (int)entry->pid, path);
 	else
-		snprintf(buf, sizeof(buf), "PID %s", spid);
-	entry->name = strdup(buf);
+		snprintf(buf, sizeof(buf), "PID %d", (int)entry->pid);
+	entry->name = intern(buf);
 	if (!entry->name)
 		entry->name = "?";
 }
 
-static int netns_get_proc_entry(struct netns_entry **result,
-				struct list *netns_list,
-				const char *spid)
-{
-	struct netns_entry *entry, *dup;
-	char path[PATH_MAX];
-	pid_t pid;
-	long kernel_id;
-
-	snprintf(path, sizeof(path), "/proc/%s/ns/net", spid);
-	kernel_id = netns_get_kernel_id(path);
-	if (kernel_id < 0) {
-		/* ignore entries that cannot be read */
-		return -1;
-	}
-	pid = atol(spid);
-	dup = netns_check_duplicate(netns_list, kernel_id);
-	if (dup) {
-		if (dup->pid && (dup->pid > pid)) {
-			dup->pid = pid;
-			netns_proc_entry_set_name(dup, spid);
-		}
-		return -1;
-	}
-
-	*result = entry = netns_create();
-	if (!entry)
-		return ENOMEM;
-
-	entry->kernel_id = kernel_id;
-	entry->pid = pid;
-	entry->fd = open(path, O_RDONLY);
-	if (entry->fd < 0) {
-		/* ignore entries that cannot be read */
-		free(entry);
-		return -1;
-	}
-	netns_proc_entry_set_name(entry, spid);
-	return 0;
-}
-
-static int netns_new_list(struct list *result, int supported)
+static int netns_new_list(struct list *result, struct hash_table *index,
+			  int supported)
 {
 	struct netns_entry *root;
 
 	root = netns_create();
 	if (!root)
 		return ENOMEM;
+	list_init(result);
+	list_append(result, node(root));
 	if (supported) {
-		root->kernel_id = netns_get_kernel_id("/proc/1/ns/net");
-		if (root->kernel_id < 0)
-			return -root->kernel_id;
+		struct stat st;
+
 		root->fd = open("/proc/1/ns/net", O_RDONLY);
 		if (root->fd < 0)
 			return errno;
+		if (fstat(root->fd, &st) < 0)
+			return errno;
+		nsfs_dev = st.st_dev;
+		root->kernel_id = st.st_ino;
+		return netns_index_add(index, root);
 	}
-
-	list_init(result);
-	list_append(result, node(root));
 	return 0;
 }
 
-static int netns_add_var_list(struct list *netns_list)
+static int netns_add_var_list(struct list *netns_list, struct hash_table *index,
+			      const char *path)
 {
 	struct netns_entry *entry;
 	struct dirent *de;
 	DIR *dir;
 	int err;
 
-	dir = opendir(NETNS_RUN_DIR);
+	dir = opendir(path);
 	if (!dir)
 		return 0;
 
@@ -228,152 +249,663 @@ static int netns_add_var_list(struct list *netns_list)
 		if (!strcmp(de->d_name, ".") ||
 		    !strcmp(de->d_name, ".."))
 			continue;
-		err = netns_get_var_entry(&entry, netns_list, de->d_name);
+		err = netns_get_var_entry(&entry, index, path, de->d_name);
 		if (err < 0) {
 			/* duplicate entry */
 			continue;
 		}
-		if (err)
+		if (!err) {
+			list_append(netns_list, node(entry));
+			err = netns_index_add(index, entry);
+		}
+		if (err) {
+			closedir(dir);
 			return err;
-		list_append(netns_list, node(entry));
+		}
 	}
 	closedir(dir);
 
 	return 0;
 }
 
-static int netns_add_proc_list(struct list *netns_list)
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+/* Gets PIDs of all processes, in the /proc order. */
+static int netns_proc_pids(pid_t **result, int *count)
 {
-	struct netns_entry *entry;
-	struct dirent *de;
-	DIR *dir;
-	int err;
+	struct linux_dirent64 *de;
+	pid_t *pids = NULL, *tmp;
+	int fd, size = 0, err = 0;
+	char *buf;
+	long len, pos;
 
-	dir = opendir("/proc");
-	if (!dir)
+	*result = NULL;
+	*count = 0;
+	fd = open("/proc", O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
 		return 0;
-
-	while ((de = readdir(dir)) != NULL) {
-		if (!strcmp(de->d_name, ".") ||
-		    !strcmp(de->d_name, ".."))
-			continue;
-		if (de->d_name[0] < '0' || de->d_name[0] > '9')
-			continue;
-		err = netns_get_proc_entry(&entry, netns_list, de->d_name);
-		if (err < 0) {
-			/* duplicate entry */
-			continue;
+	buf = malloc(NETNS_PROC_BUF);
+	if (!buf) {
+		err = ENOMEM;
+		goto out;
+	}
+	while ((len = syscall(__NR_getdents64, fd, buf, NETNS_PROC_BUF)) > 0) {
+		for (pos = 0; pos < len; pos += de->d_reclen) {
+			de = (struct linux_dirent64 *)(buf + pos);
+			if (de->d_name[0] < '0' || de->d_name[0] > '9')
+				continue;
+			if (*count == size) {
+				size = size ? size * 2 : 1024;
+				tmp = realloc(pids, size * sizeof(*pids));
+				if (!tmp) {
+					err = ENOMEM;
+					goto out;
+				}
+				pids = tmp;
+			}
+			pids[(*count)++] = atol(de->d_name);
 		}
-		if (err)
+	}
+	if (len < 0)
+		err = errno;
+out:
+	free(buf);
+	close(fd);
+	if (err) {
+		free(pids);
+		pids = NULL;
+		*count = 0;
+	}
+	*result = pids;
+	return err;
+}
+
+/* Adds the name space of the task, unless it's already known. Tasks that
+ * are gone or have changed the name space meanwhile are ignored. */
+static int netns_add_task(struct list *netns_list, struct hash_table *index,
+			  pid_t pid, long kernel_id)
+{
+	struct netns_entry *entry, *dup;
+	char path[PATH_MAX];
+	struct stat st;
+
+	dup = netns_check_duplicate(index, kernel_id);
+	if (dup) {
+		if (dup->pid && dup->pid > pid)
+			dup->pid = pid;
+		return 0;
+	}
+	entry = netns_create();
+	if (!entry)
+		return ENOMEM;
+	snprintf(path, sizeof(path), "/proc/%d/ns/net", (int)pid);
+	entry->fd = open(path, O_RDONLY);
+	if (entry->fd < 0 || fstat(entry->fd, &st) < 0 ||
+	    (long)st.st_ino != kernel_id) {
+		if (entry->fd >= 0)
+			close(entry->fd);
+		free(entry);
+		return 0;
+	}
+	entry->kernel_id = kernel_id;
+	entry->pid = pid;
+	list_append(netns_list, node(entry));
+	return netns_index_add(index, entry);
+}
+
+/* Adds the name spaces of the PIDs given on the command line. */
+static int netns_add_pid_list(struct list *netns_list, struct hash_table *index)
+{
+	struct netns_pid *ptr;
+	char path[PATH_MAX];
+	struct stat st;
+	int err;
+
+	list_for_each(ptr, ns_pids) {
+		snprintf(path, sizeof(path), "/proc/%d/ns/net", (int)ptr->pid);
+		if (stat(path, &st) < 0)
+			return errno == ENOENT ? ESRCH : errno;
+		if ((err = netns_add_task(netns_list, index, ptr->pid, st.st_ino)))
 			return err;
-		list_append(netns_list, node(entry));
 	}
-	closedir(dir);
+	return 0;
+}
 
+struct netns_proc_walk {
+	pid_t *pids;
+	/* kernel_id for each of pids, 0 if not interesting */
+	long *ids;
+	long root_id;
+	int start, end;
+};
+
+static void *netns_proc_walker(void *arg)
+{
+	struct netns_proc_walk *walk = arg;
+	char path[PATH_MAX];
+	struct stat st;
+	int i;
+
+	for (i = walk->start; i < walk->end; i++) {
+		walk->ids[i] = 0;
+		snprintf(path, sizeof(path), "/proc/%d/ns/net", (int)walk->pids[i]);
+		/* Ignore entries that cannot be read. Every task is stat'ed,
+		 * kernel threads included; telling those apart would cost
+		 * another syscall. Tasks in the root name space are the vast
+		 * majority, they are dropped here in parallel instead of in
+		 * the serial netns_add_task loop. */
+		if (stat(path, &st) < 0 || st.st_dev != nsfs_dev ||
+		    (long)st.st_ino == walk->root_id)
+			continue;
+		walk->ids[i] = st.st_ino;
+	}
+	return NULL;
+}
+
+/* Stats the name spaces of all the pids, split among up to jobs threads. */
+static int netns_proc_walk_all(pid_t *pids, long *ids, int count, long root_id)
+{
+	struct netns_proc_walk *walks;
+	pthread_t *workers;
+	int i, threads, started;
+
+	threads = (count + NETNS_PROC_CHUNK - 1) / NETNS_PROC_CHUNK;
+	if (threads > jobs)
+		threads = jobs;
+	if (threads < 1)
+		threads = 1;
+
+	walks = calloc(threads, sizeof(*walks));
+	workers = calloc(threads, sizeof(*workers));
+	if (!walks || !workers) {
+		free(walks);
+		free(workers);
+		return ENOMEM;
+	}
+	for (i = 0; i < threads; i++) {
+		walks[i].pids = pids;
+		walks[i].ids = ids;
+		walks[i].root_id = root_id;
+		walks[i].start = (long)count * i / threads;
+		walks[i].end = (long)count * (i + 1) / threads;
+	}
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&workers[i], NULL, netns_proc_walker, &walks[i]))
+			break;
+	started = i;
+	/* The first range is walked by the current thread, as well as
+	 * ranges of threads that could not be created. */
+	netns_proc_walker(&walks[0]);
+	for (; i < threads; i++)
+		netns_proc_walker(&walks[i]);
+	for (i = 1; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	free(walks);
 	return 0;
 }
 
-/* Returns -1 if netnsids are not supported. */
-static int netns_get_id(struct nl_handle *hnd, struct netns_entry *entry)
+static int netns_add_proc_list(struct list *netns_list, struct hash_table *index)
+{
+	struct netns_entry *root = list_head(*netns_list);
+	pid_t *pids;
+	long *ids;
+	int i, count, err;
+
+	if ((err = netns_proc_pids(&pids, &count)))
+		return err;
+	ids = calloc(count ? count : 1, sizeof(*ids));
+	if (!ids) {
+		err = ENOMEM;
+		goto out;
+	}
+	if ((err = netns_proc_walk_all(pids, ids, count, root->kernel_id)))
+		goto out;
+
+	for (i = 0; i < count; i++) {
+		if (!ids[i])
+			continue;
+		if ((err = netns_add_task(netns_list, index, pids[i], ids[i])))
+			goto out;
+	}
+
+out:
+	free(ids);
+	free(pids);
+	return err;
+}
+
+static struct nlmsg *netns_id_request(struct netns_entry *entry)
 {
-	struct nlmsg *req, *resp;
-	int res = -1;
+	struct nlmsg *req;
 
 	req = rtnlmsg_new(RTM_GETNSID, AF_UNSPEC, 0, sizeof(struct rtgenmsg));
 	if (!req)
+		return NULL;
+	if (nla_put_u32(req, NETNSA_FD, entry->fd)) {
+		nlmsg_free(req);
+		return NULL;
+	}
+	return req;
+}
+
+/* Returns -1 if the reply does not contain a valid netnsid. */
+static int netns_parse_id(struct nlmsg *resp)
+{
+	if (!resp || !nlmsg_get(resp, sizeof(struct rtgenmsg)))
 		return -1;
-	if (nla_put_u32(req, NETNSA_FD, entry->fd))
-		goto out_req;
-	if (nl_exchange(hnd, req, &resp))
-		goto out_req;
-	if (!nlmsg_get(resp, sizeof(struct rtgenmsg)))
-		goto out_resp;
 	for_each_nla(a, resp) {
-		if (a->nla_type == NETNSA_NSID) {
-			res = nla_read_s32(a);
-			break;
-		}
+		if (a->nla_type == NETNSA_NSID)
+			return nla_read_s32(a);
 	}
+	return -1;
+}
 
-out_resp:
-	nlmsg_free(resp);
-out_req:
+static int netns_count_id(struct nlmsg *msg, void *arg)
+{
+	if (netns_parse_id(msg) >= 0)
+		(*(int *)arg)++;
+	return 0;
+}
+
+static void netns_count_restart(void *arg)
+{
+	*(int *)arg = 0;
+}
+
+/* Returns the number of netnsids assigned in the current name space, or -1
+ * if it cannot be determined (dumping of netnsids is not supported). */
+static int netns_count_ids(struct nl_handle *hnd)
+{
+	struct nlmsg *req;
+	int count = 0;
+
+	req = rtnlmsg_new(RTM_GETNSID, AF_UNSPEC, NLM_F_DUMP, sizeof(struct rtgenmsg));
+	if (!req)
+		return -1;
+	if (nl_dump(hnd, req, netns_count_id, netns_count_restart, &count))
+		count = -1;
 	nlmsg_free(req);
-	return res;
+	return count;
 }
 
 /* This is best effort only, if anything fails (e.g. netnsids are not
- * supported by kernel), we fail back to heuristics. */
+ * supported by kernel), we fail back to heuristics.
+ *
+ * The dump of netnsids tells how many ids are assigned but not which name
+ * spaces they belong to. The name spaces are thus queried by their fds, in
+ * batches, until all the assigned ids are found. */
 static void netns_get_all_ids(struct netns_entry *current, struct list *netns_list)
 {
-	struct nl_handle hnd;
+	struct nlmsg *req[NETNS_NSID_BATCH], *resp[NETNS_NSID_BATCH];
+	struct netns_entry *batch[NETNS_NSID_BATCH];
+	struct nl_handle *hnd;
 	struct netns_entry *entry;
 	struct netns_id *nsid;
-	int id;
+	int i, count, id, remaining;
 
-	if (netns_switch(current))
+	/* The socket normally exists already from the scan. */
+	if (!current->rtnl && netns_switch(current))
 		return;
-	if (rtnl_open(&hnd) < 0)
+	if (netns_rtnl(current, &hnd))
 		return;
 
-	list_init(&current->ids);
+	remaining = netns_count_ids(hnd);
+	entry = list_head(*netns_list);
+	while (remaining && node_valid(entry)) {
+		for (count = 0; count < NETNS_NSID_BATCH && node_valid(entry);
+		     entry = node_next(entry)) {
+			req[count] = netns_id_request(entry);
+			if (!req[count])
+				break;
+			batch[count++] = entry;
+		}
+		if (!count || nl_exchange_many(hnd, req, resp, count)) {
+			while (count--)
+				nlmsg_free(req[count]);
+			break;
+		}
+		for (i = 0; i < count; i++) {
+			id = netns_parse_id(resp[i]);
+			nlmsg_free(resp[i]);
+			nlmsg_free(req[i]);
+			if (id < 0)
+				continue;
+			nsid = arena_alloc(&current->arena, sizeof(*nsid));
+			if (!nsid)
+				continue;
+			nsid->ns = batch[i];
+			nsid->id = id;
+			if (hash_add(&current->ids, &nsid->n, hash_u32(id)))
+				continue;
+			if (remaining > 0)
+				remaining--;
+		}
+	}
+}
+
+/* Hands out up to size consecutive entries. Returns the number of entries
+ * stored to window, 0 if there's nothing left. */
+static int netns_scan_next(struct netns_scan *scan, struct netns_entry **window,
+			   int size)
+{
+	int count = 0;
+
+	pthread_mutex_lock(&scan->lock);
+	while (!scan->err && count < size && node_valid(scan->next)) {
+		window[count++] = scan->next;
+		scan->next = node_next(scan->next);
+	}
+	pthread_mutex_unlock(&scan->lock);
+	return count;
+}
+
+static void netns_scan_fail(struct netns_scan *scan, int err)
+{
+	pthread_mutex_lock(&scan->lock);
+	if (!scan->err)
+		scan->err = err;
+	pthread_mutex_unlock(&scan->lock);
+}
+
+static int netns_scan_one(struct netns_entry *entry)
+{
+	int err;
+
+	if (entry->name) {
+		/* Do not try to switch to the root netns. It is always the
+		 * first entry handed out, so whoever gets it is still in the
+		 * root netns, and netns_switch fails hard if there's no netns
+		 * support available. */
+		if ((err = netns_switch(entry)))
+			return err;
+	}
+	if ((err = sysfs_mount(entry->name)))
+		return err;
+	if ((err = if_list(&entry->ifaces, entry)))
+		return err;
+	if ((err = netns_handler_scan(entry)))
+		return err;
+	sysfs_umount();
+	if (entry->inconsistent)
+		return label_add(&entry->arena, &entry->warnings,
+				 "%s: configuration changed during the scan, data may be inconsistent",
+				 entry->name ? entry->name : "root name space");
+	return 0;
+}
+
+/* Gets the link, address and route dumps of all name spaces in the window
+ * at once. The socket of each of the name spaces is opened, then the dumps
+ * are driven from a single epoll loop, keeping one dump in flight per
+ * socket. This is best effort: whatever is not prefetched is dumped
+ * synchronously by the scan. */
+static void netns_prefetch(struct netns_entry **window, int count)
+{
+	struct rtnl_filter link_filter = {
+		.ext_mask = if_handler_link_ext(),
+	};
+	struct nl_request req[NETNS_PREFETCH_WINDOW][3];
+	struct nl_batch batch;
+	struct nl_handle *hnd;
+	int i, j, switched = 0;
 
-	list_for_each(entry, *netns_list) {
-		id = netns_get_id(&hnd, entry);
-		if (id < 0)
+	if (nl_batch_init(&batch))
+		return;
+	memset(req, 0, sizeof(req));
+	for (i = 0; i < count; i++) {
+		if (window[i]->name) {
+			if (netns_switch(window[i]))
+				continue;
+			switched = 1;
+		}
+		if (netns_rtnl(window[i], &hnd))
 			continue;
-		nsid = malloc(sizeof(*nsid));
-		if (!nsid)
+		req[i][0].src = rtnl_dump_req(RTM_GETLINK, AF_UNSPEC, &link_filter);
+		req[i][1].src = rtnl_dump_req(RTM_GETADDR, AF_UNSPEC, NULL);
+		req[i][2].src = route_dump_req();
+		for (j = 0; j < 3; j++) {
+			req[i][j].hnd = hnd;
+			if (req[i][j].src)
+				nl_batch_add(&batch, &req[i][j]);
+		}
+	}
+	/* The root entry, if present, is scanned without switching. */
+	if (switched)
+		netns_switch_root();
+
+	if (nl_batch_run(&batch)) {
+		for (i = 0; i < count; i++)
+			for (j = 0; j < 3; j++)
+				nlmsg_free(req[i][j].dest);
+	} else {
+		for (i = 0; i < count; i++) {
+			window[i]->link_dump = req[i][0].err ? NULL : req[i][0].dest;
+			window[i]->addr_dump = req[i][1].err ? NULL : req[i][1].dest;
+			window[i]->route_dump = req[i][2].err ? NULL : req[i][2].dest;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < 3; j++)
+			nlmsg_free(req[i][j].src);
+	nl_batch_free(&batch);
+}
+
+/* Scans name spaces from the shared queue until it's empty or any worker
+ * fails. Each worker is a separate thread with its own current netns and
+ * its own sysfs mount point. */
+static void *netns_scan_worker(void *arg)
+{
+	struct netns_scan *scan = arg;
+	struct netns_entry *window[NETNS_PREFETCH_WINDOW];
+	int i, count, err;
+
+	if ((err = sysfs_init())) {
+		netns_scan_fail(scan, err);
+		return NULL;
+	}
+	while ((count = netns_scan_next(scan, window, scan->window))) {
+		if (async_dumps)
+			netns_prefetch(window, count);
+		for (i = 0; i < count; i++) {
+			if ((err = netns_scan_one(window[i]))) {
+				netns_scan_fail(scan, err);
+				goto out;
+			}
+		}
+	}
+out:
+	sysfs_clean();
+	return NULL;
+}
+
+static int netns_scan_all(struct list *netns_list)
+{
+	struct netns_scan scan = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.next = list_head(*netns_list),
+	};
+	struct netns_entry *entry;
+	pthread_t *workers;
+	int i, count, err;
+
+	count = 0;
+	list_for_each(entry, *netns_list)
+		count++;
+	if (jobs > 1)
+		scan.window = (count + jobs - 1) / jobs;
+	else
+		scan.window = count;
+	if (!async_dumps || scan.window < 1)
+		scan.window = 1;
+	if (scan.window > NETNS_PREFETCH_WINDOW)
+		scan.window = NETNS_PREFETCH_WINDOW;
+	if (count > jobs)
+		count = jobs;
+	if (count <= 1) {
+		netns_scan_worker(&scan);
+		return scan.err;
+	}
+
+	workers = calloc(count, sizeof(*workers));
+	if (!workers)
+		return ENOMEM;
+	for (i = 0; i < count; i++) {
+		if ((err = pthread_create(&workers[i], NULL, netns_scan_worker, &scan))) {
+			netns_scan_fail(&scan, err);
 			break;
-		nsid->ns = entry;
-		nsid->id = id;
-		list_append(&current->ids, node(nsid));
+		}
 	}
-	nl_close(&hnd);
+	while (i--)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	return scan.err;
 }
 
-int netns_fill_list(struct list *result, int supported)
+static int netns_match(struct list *patterns, const char *name)
+{
+	struct netns_arg *ptr;
+
+	list_for_each(ptr, *patterns)
+		if (!fnmatch(ptr->arg, name, 0))
+			return 1;
+	return 0;
+}
+
+/* Drops the name spaces not selected by --include-ns and --exclude-ns
+ * before they are scanned. The root name space is always kept. */
+static void netns_prune(struct list *netns_list)
+{
+	struct netns_entry *entry, *next;
+
+	for (entry = list_head(*netns_list); node_valid(entry); entry = next) {
+		next = node_next(entry);
+		if (!entry->name)
+			continue;
+		if ((list_empty(ns_include) || netns_match(&ns_include, entry->name)) &&
+		    !netns_match(&ns_exclude, entry->name))
+			continue;
+		node_remove(node(entry));
+		if (!capture_replaying())
+			close(entry->fd);
+		arena_free(&entry->arena);
+		free(entry);
+	}
+}
+
+/* Every name space entry holds its fd and netlink sockets open until the
+ * end, which easily exceeds the default soft limit on large hosts. */
+static void netns_raise_fd_limit(void)
 {
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) || rl.rlim_cur >= rl.rlim_max)
+		return;
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+/* Finds the name spaces of the system. */
+static int netns_gather_list(struct list *result, int supported)
+{
+	struct hash_table index = HASH_INITIALIZER;
 	struct netns_entry *entry;
+	struct netns_arg *arg;
 	int err;
 
-	err = netns_new_list(result, supported);
+	err = netns_new_list(result, &index, supported);
+	if (!err && supported && !root_only) {
+		err = netns_add_var_list(result, &index, NETNS_RUN_DIR);
+		list_for_each(arg, ns_dirs)
+			if (!err)
+				err = netns_add_var_list(result, &index, arg->arg);
+		if (!err)
+			err = netns_add_pid_list(result, &index);
+		if (!err && !no_proc)
+			err = netns_add_proc_list(result, &index);
+	}
+	hash_free(&index, NULL);
 	if (err)
 		return err;
-	if (supported) {
-		err = netns_add_var_list(result);
-		if (err)
-			return err;
-		err = netns_add_proc_list(result);
-		if (err)
-			return err;
+
+	/* Name the name spaces found via processes after the lowest PID
+	 * found in each of them. */
+	list_for_each(entry, *result)
+		if (entry->pid)
+			netns_proc_entry_set_name(entry);
+	return 0;
+}
+
+static int netns_replay_entry(const char *name, long kernel_id, pid_t pid,
+			      int fd, void *arg)
+{
+	struct netns_entry *entry;
+
+	entry = netns_create();
+	if (!entry)
+		return ENOMEM;
+	list_append(arg, node(entry));
+	if (name) {
+		entry->name = intern(name);
+		if (!entry->name)
+			return ENOMEM;
 	}
+	entry->kernel_id = kernel_id;
+	entry->pid = pid;
+	/* The fd is not valid; it's used only in the replayed requests. */
+	entry->fd = fd;
+	return 0;
+}
 
-	if ((err = sysfs_init()))
-		return err;
+static int netns_set_id(struct netns_entry *entry)
+{
+	char buf[PATH_MAX + 1];
+
+	if (!entry->name) {
+		entry->id = "/";
+		return 0;
+	}
+	snprintf(buf, sizeof(buf), "%s/", entry->name);
+	entry->id = intern(buf);
+	return entry->id ? 0 : ENOMEM;
+}
+
+int netns_fill_list(struct list *result, int supported)
+{
+	struct netns_entry *entry;
+	int err;
 
+	if (capture_replaying()) {
+		list_init(result);
+		err = capture_for_each_netns(netns_replay_entry, result);
+	} else {
+		err = netns_gather_list(result, supported);
+	}
+	if (err)
+		return err;
+	netns_prune(result);
 	list_for_each(entry, *result) {
-		if (entry->name) {
-			/* Do not try to switch to the root netns, as we're
-			 * already there when processing the first entry,
-			 * and netns_switch fails hard if there's no netns
-			 * support available. */
-			if ((err = netns_switch(entry)))
-				return err;
-		}
-		if ((err = sysfs_mount(entry->name)))
-			return err;
-		if ((err = if_list(&entry->ifaces, entry)))
+		if ((err = netns_set_id(entry)))
 			return err;
-		if ((err = netns_handler_scan(entry)))
-			return err;
-		sysfs_umount();
+		capture_put_netns(entry->name, entry->kernel_id, entry->pid,
+				  entry->fd);
 	}
+	netns_raise_fd_limit();
+
+	if ((err = netns_scan_all(result)))
+		return err;
 	/* Walk all net name spaces again and gather all kernel assigned
 	 * netnsids. We don't assign netnsids ourselves to prevent assigning
 	 * them needlessly - the kernel assigns only those that are really
 	 * needed while doing netlinks dumps. Note also that netnsids are
-	 * per name space and this is O(n^2). */
+	 * per name space; the lookups are batched and stop once all the
+	 * assigned ids are known, which is usually very early. */
 	list_for_each(entry, *result)
 		netns_get_all_ids(entry, result);
 	/* And finally, resolve netnsid+ifindex to the if_entry pointers. */
@@ -397,6 +929,9 @@ static int do_netns_switch(int fd)
 
 int netns_switch(struct netns_entry *dest)
 {
+	capture_set_netns(dest->name ? dest->kernel_id : 0);
+	if (capture_replaying())
+		return 0;
 	return do_netns_switch(dest->fd);
 }
 
@@ -407,6 +942,9 @@ int netns_switch_root(void)
 {
 	int fd, res;
 
+	capture_set_netns(0);
+	if (capture_replaying())
+		return 0;
 	fd = open("/proc/1/ns/net", O_RDONLY);
 	if (fd < 0) {
 		res = errno;
@@ -421,15 +959,206 @@ int netns_switch_root(void)
 	return res;
 }
 
+static int netns_nl_open(struct nl_handle **cache, struct nl_handle **hnd,
+			 int (*open_f)(struct nl_handle *))
+{
+	int err;
+
+	if (!*cache) {
+		*cache = malloc(sizeof(**cache));
+		if (!*cache)
+			return ENOMEM;
+		if ((err = open_f(*cache))) {
+			free(*cache);
+			*cache = NULL;
+			return err < 0 ? -err : err;
+		}
+	}
+	*hnd = *cache;
+	return 0;
+}
+
+static void netns_nl_close(struct nl_handle **cache)
+{
+	if (!*cache)
+		return;
+	nl_close(*cache);
+	free(*cache);
+	*cache = NULL;
+}
+
+/* Return the rtnetlink or genetlink socket of the name space. The socket
+ * is created on the first call, in the current name space of the calling
+ * thread; the caller has to be switched to ns at that point. Once created,
+ * the socket can be used from any name space and is reused until the ns
+ * entry is freed. */
+int netns_rtnl(struct netns_entry *ns, struct nl_handle **hnd)
+{
+	return netns_nl_open(&ns->rtnl, hnd, rtnl_open);
+}
+
+int netns_genl(struct netns_entry *ns, struct nl_handle **hnd)
+{
+	return netns_nl_open(&ns->genl, hnd, genl_open);
+}
+
+/* Similarly to netns_rtnl, the socket is created in the current name
+ * space of the calling thread on the first call. */
+int netns_ioctl_sock(struct netns_entry *ns, int *fd)
+{
+	if (ns->ioctl_fd < 0) {
+		ns->ioctl_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if (ns->ioctl_fd < 0)
+			return errno;
+	}
+	*fd = ns->ioctl_fd;
+	return 0;
+}
+
+/* The gathered data are freed at once with the arena; only the indexes
+ * and the system resources are released one by one. */
 static void netns_list_destruct(struct netns_entry *entry)
 {
 	netns_handler_cleanup(entry);
-	list_free(&entry->ids, NULL);
 	if_list_free(&entry->ifaces);
-	free(entry->name);
+	hash_clear(&entry->ids);
+	hash_clear(&entry->if_index);
+	tunnel_index_free(entry);
+	nlmsg_free(entry->link_dump);
+	nlmsg_free(entry->addr_dump);
+	nlmsg_free(entry->route_dump);
+	netns_nl_close(&entry->rtnl);
+	netns_nl_close(&entry->genl);
+	if (entry->ioctl_fd >= 0)
+		close(entry->ioctl_fd);
+	arena_free(&entry->arena);
 }
 
 void netns_list_free(struct list *netns_list)
 {
+	match_index_free();
 	list_free(netns_list, (destruct_f)netns_list_destruct);
 }
+
+static int set_async_dumps(_unused char *arg)
+{
+	async_dumps = 1;
+	return 0;
+}
+
+static int set_root_only(_unused char *arg)
+{
+	root_only = 1;
+	return 0;
+}
+
+static int set_no_proc(_unused char *arg)
+{
+	no_proc = 1;
+	return 0;
+}
+
+static int add_arg(struct list *list, char *arg)
+{
+	struct netns_arg *ptr;
+
+	ptr = malloc(sizeof(*ptr));
+	if (!ptr)
+		return ENOMEM;
+	ptr->arg = strdup(arg);
+	if (!ptr->arg) {
+		free(ptr);
+		return ENOMEM;
+	}
+	list_append(list, node(ptr));
+	return 0;
+}
+
+static int add_include(char *arg)
+{
+	return add_arg(&ns_include, arg);
+}
+
+static int add_exclude(char *arg)
+{
+	return add_arg(&ns_exclude, arg);
+}
+
+static int add_dir(char *arg)
+{
+	return add_arg(&ns_dirs, arg);
+}
+
+static int add_pids(char *arg)
+{
+	struct netns_pid *ptr;
+	char *s, *endptr;
+	long pid;
+
+	for (s = arg; *s; s = endptr + (*endptr == ',')) {
+		pid = strtol(s, &endptr, 10);
+		if (endptr == s || pid <= 0 || (*endptr && *endptr != ',')) {
+			fprintf(stderr, "Invalid PID list: %s\n", arg);
+			return 1;
+		}
+		ptr = malloc(sizeof(*ptr));
+		if (!ptr)
+			return ENOMEM;
+		ptr->pid = pid;
+		list_append(&ns_pids, node(ptr));
+	}
+	return 0;
+}
+
+static void netns_arg_destruct(struct netns_arg *ptr)
+{
+	free(ptr->arg);
+}
+
+static struct arg_option options[] = {
+	{ .long_name = "jobs", .short_name = 'j', .has_arg = 1,
+	  .type = ARG_INT, .action.int_var = &jobs,
+	  .help = "number of name spaces scanned in parallel",
+	},
+	{ .long_name = "async-dumps", .short_name = '\0',
+	  .type = ARG_CALLBACK, .action.callback = set_async_dumps,
+	  .help = "prefetch netlink dumps of many name spaces at once",
+	},
+	{ .long_name = "include-ns", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = add_include,
+	  .help = "scan only name spaces matching the glob (repeatable)",
+	},
+	{ .long_name = "exclude-ns", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = add_exclude,
+	  .help = "do not scan name spaces matching the glob (repeatable)",
+	},
+	{ .long_name = "root-only", .short_name = '\0',
+	  .type = ARG_CALLBACK, .action.callback = set_root_only,
+	  .help = "scan only the root name space",
+	},
+	{ .long_name = "pid", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = add_pids,
+	  .help = "scan name spaces of the given comma separated PIDs",
+	},
+	{ .long_name = "netns-dir", .short_name = '\0', .has_arg = 1,
+	  .type = ARG_CALLBACK, .action.callback = add_dir,
+	  .help = "look for name spaces also in the directory (repeatable)",
+	},
+	{ .long_name = "no-proc", .short_name = '\0',
+	  .type = ARG_CALLBACK, .action.callback = set_no_proc,
+	  .help = "do not look for name spaces of running processes",
+	},
+};
+
+void netns_init(void)
+{
+	arg_register_batch(options, ARRAY_SIZE(options));
+}
+
+void netns_cleanup(void)
+{
+	list_free(&ns_include, (destruct_f)netns_arg_destruct);
+	list_free(&ns_exclude, (destruct_f)netns_arg_destruct);
+	list_free(&ns_dirs, (destruct_f)netns_arg_destruct);
+	list_free(&ns_pids, NULL);
+}
@@ -17,36 +17,67 @@
 #define _NETNS_H
 
 #include <sys/types.h>
+#include "arena.h"
+#include "hash.h"
 #include "if.h"
 #include "list.h"
 
 struct label;
 struct netns_entry;
+struct nl_handle;
+struct nlmsg;
 struct route;
 
 struct netns_id {
-	struct node n;
+	struct hash_node n;
 	struct netns_entry *ns;
 	int id;
 };
 
 struct netns_entry {
 	struct node n;
+	/* Everything gathered about the name space (interfaces, addresses,
+	 * labels, routes, handler data) is allocated from here and freed
+	 * at once with the entry. */
+	struct arena arena;
 	struct list ifaces;
+	/* the interfaces keyed by ifindex, see if_find_index */
+	struct hash_table if_index;
 	struct list warnings;
 	long kernel_id;
 	/* name is NULL for root name space, for other name spaces it
 	 * contains human recognizable identifier */
-	char *name;
+	const char *name;
+	/* the id used by the frontends, see nsid() */
+	const char *id;
 	pid_t pid;
 	int fd;
-	struct list ids;
+	/* netns_id entries keyed by the netnsid */
+	struct hash_table ids;
 	struct list rtables;
+	/* rtnetlink dumps fetched in advance (--async-dumps); consumed and
+	 * reset to NULL by the scan */
+	struct nlmsg *link_dump, *addr_dump, *route_dump;
+	/* netlink sockets living in this name space, opened on demand by
+	 * netns_rtnl and netns_genl and kept until the entry is freed */
+	struct nl_handle *rtnl, *genl;
+	/* socket for ioctls, -1 until netns_ioctl_sock is called */
+	int ioctl_fd;
+	/* local addresses of the interfaces, built by tunnel.c on demand */
+	struct hash_table tunnel_addrs;
+	int tunnel_addrs_built;
+	/* the configuration changed while being dumped */
+	int inconsistent;
 };
 
+void netns_init(void);
+void netns_cleanup(void);
 int netns_fill_list(struct list *result, int supported);
 void netns_list_free(struct list *list);
 int netns_switch(struct netns_entry *dest);
 int netns_switch_root(void);
+int netns_rtnl(struct netns_entry *ns, struct nl_handle **hnd);
+int netns_genl(struct netns_entry *ns, struct nl_handle **hnd);
+int netns_ioctl_sock(struct netns_entry *ns, int *fd);
 
 #endif
@@ -22,11 +22,14 @@
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "capture.h"
 
 #define PATH "/tmp/plotnetcfg-sys-XXXXXX"
 #define LEN sizeof(PATH)
 
-static char sysfs_mountpoint[LEN];
+/* Every thread scanning a name space needs its own mount point, the sysfs
+ * instance is bound to the netns of the thread that mounted it. */
+static __thread char sysfs_mountpoint[LEN];
 long page_size;
 
 void sysfs_clean()
@@ -44,18 +47,20 @@ void sysfs_clean()
 
 int sysfs_init()
 {
+	page_size = sysconf(_SC_PAGESIZE);
+	if (capture_replaying())
+		return 0;
+
 	strcpy(sysfs_mountpoint, PATH);
 	if (!mkdtemp(sysfs_mountpoint))
 		return errno;
-
-	page_size = sysconf(_SC_PAGESIZE);
-
-	atexit(sysfs_clean);
 	return 0;
 }
 
 int sysfs_mount(const char *name)
 {
+	if (capture_replaying())
+		return 0;
 	sysfs_umount();
 	if (mount(name, sysfs_mountpoint, "sysfs", 0, NULL) < 0)
 		return errno;
@@ -64,14 +69,35 @@ int sysfs_mount(const char *name)
 
 void sysfs_umount()
 {
+	if (capture_replaying())
+		return;
 	umount2(sysfs_mountpoint, MNT_DETACH);
 }
 
+static char *sysfs_realpath_replay(const char *sys_path)
+{
+	char *resolved;
+	void *val;
+	int len;
+
+	if (capture_get(CAPTURE_SYSFS_REALPATH, sys_path, &val, &len))
+		return NULL;
+	/* keep the layout expected by sysfs_free */
+	resolved = malloc(LEN + len + 1);
+	if (resolved)
+		memcpy(resolved + LEN, val, len + 1);
+	free(val);
+	return resolved ? resolved + LEN : NULL;
+}
+
 char *sysfs_realpath(const char *sys_path)
 {
 	char *resolved;
 	char *path;
 
+	if (capture_replaying())
+		return sysfs_realpath_replay(sys_path);
+
 	if (asprintf(&path, "%s/%s", sysfs_mountpoint, sys_path) < 0)
 		return NULL;
 
@@ -79,10 +105,41 @@ char *sysfs_realpath(const char *sys_path)
 
 	free(path);
 
-	return resolved ? resolved + LEN : NULL;
+	if (!resolved) {
+		capture_put(CAPTURE_SYSFS_REALPATH, sys_path, NULL, 0, ENOENT);
+		return NULL;
+	}
+	capture_put(CAPTURE_SYSFS_REALPATH, sys_path, resolved + LEN,
+		    strlen(resolved + LEN), 0);
+	return resolved + LEN;
 }
 
-ssize_t sysfs_readfile(char **dest, const char *sys_path)
+static ssize_t sysfs_readfile_replay(char **dest, const char *sys_path)
+{
+	void *val;
+	int len, err;
+
+	*dest = NULL;
+	err = capture_get(CAPTURE_SYSFS_READ, sys_path, &val, &len);
+	if (err)
+		return -err;
+	if (!len) {
+		free(val);
+		return 0;
+	}
+	*dest = malloc(page_size);
+	if (!*dest) {
+		free(val);
+		return -ENOMEM;
+	}
+	if (len > page_size)
+		len = page_size;
+	memcpy(*dest, val, len);
+	free(val);
+	return len;
+}
+
+static ssize_t sysfs_readfile_raw(char **dest, const char *sys_path)
 {
 	ssize_t ret;
 	char *path;
@@ -121,6 +178,18 @@ err:
 	return ret;
 }
 
+ssize_t sysfs_readfile(char **dest, const char *sys_path)
+{
+	ssize_t ret;
+
+	if (capture_replaying())
+		return sysfs_readfile_replay(dest, sys_path);
+	ret = sysfs_readfile_raw(dest, sys_path);
+	capture_put(CAPTURE_SYSFS_READ, sys_path, *dest, ret > 0 ? ret : 0,
+		    ret < 0 ? -ret : 0);
+	return ret;
+}
+
 void sysfs_free(char *path)
 {
 	free(path - LEN);
@@ -18,7 +18,12 @@
 
 #include <sys/types.h>
 
+/*
+ * The mount point is per thread. Every thread calling sysfs_init must call
+ * sysfs_clean when it's done.
+ */
 int sysfs_init();
+void sysfs_clean();
 int sysfs_mount(const char *name);
 void sysfs_umount();
 
@@ -14,54 +14,122 @@
  */
 
 #include "tunnel.h"
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include "addr.h"
+#include "arena.h"
+#include "hash.h"
 #include "if.h"
-#include "match.h"
+#include "netns.h"
 
-static int match_tunnel(struct if_entry *entry, void *arg)
+/* A local address, with the interface having it. Only interfaces that
+ * are up are considered. */
+struct tunnel_addr {
+	struct hash_node n;
+	int family;
+	const void *raw;
+	struct if_entry *entry;
+	/* number of interfaces having the address */
+	int count;
+};
+
+static int tunnel_addr_len(int family)
 {
-	struct addr *data = arg;
-	struct if_addr *addr;
+	return family == AF_INET ? 4 : 16;
+}
 
-	if (!(entry->flags & IF_UP))
+static unsigned int tunnel_addr_hash(int family, const void *raw)
+{
+	return hash_mem(raw, tunnel_addr_len(family)) ^ family;
+}
+
+static struct tunnel_addr *tunnel_addr_find(struct netns_entry *ns, int family,
+					    const void *raw)
+{
+	struct tunnel_addr *ptr;
+
+	hash_for_each_match(ptr, ns->tunnel_addrs, tunnel_addr_hash(family, raw))
+		if (ptr->family == family &&
+		    !memcmp(ptr->raw, raw, tunnel_addr_len(family)))
+			return ptr;
+	return NULL;
+}
+
+static int tunnel_addr_add(struct netns_entry *ns, struct if_entry *entry,
+			   struct addr *addr)
+{
+	struct tunnel_addr *ptr;
+
+	ptr = tunnel_addr_find(ns, addr->family, addr->raw);
+	if (ptr) {
+		/* the same address may be present with different prefixes */
+		if (ptr->entry != entry) {
+			ptr->entry = entry;
+			ptr->count++;
+		}
 		return 0;
-	list_for_each(addr, entry->addr) {
-		if (addr->addr.family != data->family)
+	}
+	ptr = arena_alloc(&ns->arena, sizeof(*ptr));
+	if (!ptr)
+		return ENOMEM;
+	ptr->family = addr->family;
+	ptr->raw = addr->raw;
+	ptr->entry = entry;
+	ptr->count = 1;
+	return hash_add(&ns->tunnel_addrs, &ptr->n,
+			tunnel_addr_hash(addr->family, addr->raw));
+}
+
+/* The index of local addresses is built on the first lookup in the name
+ * space, after all the interfaces are scanned. */
+static int tunnel_index_build(struct netns_entry *ns)
+{
+	struct if_entry *entry;
+	struct if_addr *addr;
+	int err;
+
+	list_for_each(entry, ns->ifaces) {
+		if (!(entry->flags & IF_UP))
 			continue;
-		if (!memcmp(addr->addr.raw, data->raw, data->family == AF_INET ? 4 : 16))
-			return 1;
+		list_for_each(addr, entry->addr) {
+			if ((err = tunnel_addr_add(ns, entry, &addr->addr))) {
+				tunnel_index_free(ns);
+				return err;
+			}
+		}
 	}
+	ns->tunnel_addrs_built = 1;
 	return 0;
 }
 
+void tunnel_index_free(struct netns_entry *ns)
+{
+	hash_clear(&ns->tunnel_addrs);
+	ns->tunnel_addrs_built = 0;
+}
+
 struct if_entry *tunnel_find_str(struct netns_entry *ns, const char *addr)
 {
 	struct addr data;
-	char buf [16];
-	struct match_desc match;
 
-	data.raw = buf;
 	data.family = addr_parse_raw(data.raw, addr);
 	if (data.family < 0)
 		return NULL;
-
-	match_init(&match);
-	match.ns = ns;
-	if (match_if(&match, match_tunnel, &data))
-		return NULL;
-	return match_ambiguous(match) ? NULL : match_found(match);
+	return tunnel_find_addr(ns, &data);
 }
 
+/* Returns NULL if the address is not found or if more interfaces have
+ * it. */
 struct if_entry *tunnel_find_addr(struct netns_entry *ns, struct addr *addr)
 {
-	struct match_desc match;
-
-	match_init(&match);
-	match.ns = ns;
+	struct tunnel_addr *ptr;
 
-	if (match_if(&match, match_tunnel, addr))
+	if (!ns->tunnel_addrs_built && tunnel_index_build(ns))
+		return NULL;
+	ptr = tunnel_addr_find(ns, addr->family, addr->raw);
+	if (!ptr || ptr->count > 1)
 		return NULL;
-	return match_ambiguous(match) ? NULL : match_found(match);
+	return ptr->entry;
 }
@@ -22,5 +22,6 @@ struct netns_entry;
 
 struct if_entry *tunnel_find_str(struct netns_entry *ns, const char *addr);
 struct if_entry *tunnel_find_addr(struct netns_entry *ns, struct addr *addr);
+void tunnel_index_free(struct netns_entry *ns);
 
 #endif
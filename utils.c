@@ -24,7 +24,9 @@
 
 char *ifstr(struct if_entry *entry)
 {
-	static char buf[IFNAMSIZ + NAME_MAX + 2];
+	/* used for warnings, which may be generated by parallel scans */
+	/* name spaces from --netns-dir are named by the full path */
+	static __thread char buf[PATH_MAX + IFNAMSIZ + 1];
 
 	if (!entry->ns->name)
 		/* root ns */
@@ -35,29 +37,22 @@ char *ifstr(struct if_entry *entry)
 }
 
 #define INTERNAL_NS_MAX (NAME_MAX)
-#define NETNS_MAX (NAME_MAX + 1)
+/* the name space name is a path for --netns-dir, see netns_set_id */
+#define NETNS_MAX (PATH_MAX + 1)
 #define IFID_MAX (INTERNAL_NS_MAX + NETNS_MAX + IFNAMSIZ + 1)
 char *ifid(struct if_entry *entry)
 {
 	static char buf[IFID_MAX + 1];
-	char *ins, *ns;
+	const char *ins;
 
 	ins = entry->internal_ns ? : "";
-	ns = nsid(entry->ns);
-
-	snprintf(buf, sizeof(buf), "%s%s/%s", ns, ins, entry->if_name);
+	snprintf(buf, sizeof(buf), "%s%s/%s", nsid(entry->ns), ins, entry->if_name);
 	return buf;
 }
 
-char *nsid(struct netns_entry *entry)
+const char *nsid(struct netns_entry *entry)
 {
-	static char buf[NETNS_MAX + 1];
-
-	if (!entry->name)
-		return "/";
-
-	snprintf(buf, sizeof(buf), "%s/", entry->name);
-	return buf;
+	return entry->id;
 }
 
 char *rtid(struct rtable *rt)
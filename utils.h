@@ -30,7 +30,8 @@ struct rtable;
 /* Returns static buffer. */
 char *ifstr(struct if_entry *entry);
 char *ifid(struct if_entry *entry);
-char *nsid(struct netns_entry *entry);
+/* Does not use a static buffer, the id is stored in the entry. */
+const char *nsid(struct netns_entry *entry);
 char *rtid(struct rtable *rt);
 
 #endif